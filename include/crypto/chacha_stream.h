@@ -0,0 +1,58 @@
+#ifndef OTMPSI_CRYPTO_CHACHASTREAM_H_
+#define OTMPSI_CRYPTO_CHACHASTREAM_H_
+
+#include <NTL/ZZ.h>
+
+#include <cstddef>
+#include <sys/types.h>
+
+#include "utils/common.h"
+
+// Class for a cryptographically secure random stream, the ChaCha20 keystream under a key drawn from the
+// operating system. The keystream is generated into a buffer several kilobytes at a time, so drawing an
+// exponent copies bytes instead of running the cipher. Every thread uses its own stream through
+// ThreadLocal(), so parallel encryptions share no generator state. A stream rekeys itself in a forked child
+class ChaChaStream {
+public:
+    // Size of the keystream buffer in bytes, a multiple of the 64-byte ChaCha20 block
+    static constexpr size_t kBufferBytes = 4096;
+
+    // Constructor that keys the stream from the operating system
+    ChaChaStream();
+
+    // Default destructor
+    ~ChaChaStream() = default;
+
+    // Delete the copy constructor and assignment, two copies would produce the same bytes
+    ChaChaStream(const ChaChaStream &) = delete;
+    ChaChaStream &operator=(const ChaChaStream &) = delete;
+
+    // Method to get the stream of the calling thread, keyed on first use
+    static ChaChaStream &ThreadLocal();
+
+    // Method to fill dest with len random bytes
+    void Fill(uint8 *dest, size_t len);
+
+    // Method to draw a uniform number in [0, 2^bits)
+    void RandomBits(NTL::ZZ &dest, long bits);
+
+    // Method to draw a uniform number in [0, bound), bound must be positive
+    void RandomBnd(NTL::ZZ &dest, const NTL::ZZ &bound);
+
+    // Method to draw a uniform number in [0, bound), bound must be positive
+    long RandomBnd(long bound);
+
+private:
+    // Method to draw a new key from the operating system and restart the keystream
+    void Rekey();
+
+    // Method to generate the next kBufferBytes bytes of keystream into the buffer
+    void Refill();
+
+    uint32 state_[16]; // constants, key, 64-bit block counter and 64-bit nonce
+    uint8 buffer_[kBufferBytes];
+    size_t position_ = kBufferBytes; // bytes of the buffer used
+    pid_t pid_ = 0; // process the key was drawn in
+};
+
+#endif // OTMPSI_CRYPTO_CHACHASTREAM_H_
@@ -0,0 +1,113 @@
+#ifndef OTMPSI_CRYPTO_CIPHERTEXTARRAY_H_
+#define OTMPSI_CRYPTO_CIPHERTEXTARRAY_H_
+
+#include <NTL/ZZ.h>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "crypto/threshold_elgamal.h"
+#include "utils/common.h"
+
+// Class for an array of ciphertexts as a structure of arrays in one aligned arena: the c1 values of all
+// ciphertexts, then their c2 values. Every value is a residue of a fixed number of little-endian 64-bit
+// limbs, so the ciphertexts of a range are two contiguous spans that can be sent and received as they
+// are. Arenas of 2 MiB and more are aligned for and advised to use transparent huge pages. An array can
+// also be backed by a file, so that the ciphertexts it holds need not fit in memory
+class CiphertextArray {
+public:
+    // Default constructor for an empty array
+    CiphertextArray() = default;
+
+    // Constructor that takes the number of ciphertexts and the size of a value in bytes
+    CiphertextArray(size_t size, uint32 number_bytes) { Resize(size, number_bytes); };
+
+    // Default destructor
+    ~CiphertextArray() = default;
+
+    // Default move constructor and assignment
+    CiphertextArray(CiphertextArray &&) = default;
+    CiphertextArray &operator=(CiphertextArray &&) = default;
+
+    // Method to reallocate the arena for size ciphertexts, number_bytes is rounded up to whole limbs.
+    // The contents are unspecified afterwards
+    void Resize(size_t size, uint32 number_bytes);
+
+    // Method to reallocate the arena as a shared mapping of a new anonymous file in directory dir, which is
+    // freed with the mapping. The contents are unspecified afterwards
+    void Map(const std::string &dir, size_t size, uint32 number_bytes);
+
+    // Method to drop the pages of ciphertexts [start, end) of a file-backed array from memory. The page
+    // cache writes them back to the file and they are read in again when next touched. No-op in memory
+    void Release(size_t start, size_t end);
+
+    // Method to check if the array is backed by a file
+    [[nodiscard]] inline bool mapped() const { return arena_.get_deleter().mapped_bytes > 0; }
+
+    // Method to get the number of ciphertexts
+    [[nodiscard]] inline size_t size() const { return size_; }
+
+    // Method to get the size of a value in bytes, a multiple of 8
+    [[nodiscard]] inline uint32 number_bytes() const { return limbs_ * sizeof(uint64); }
+
+    // Method to get the number of limbs of a value
+    [[nodiscard]] inline uint32 limbs() const { return limbs_; }
+
+    // Method to get the c1 value of ciphertext i, the c1 values of i + 1, ... follow it
+    inline uint8 *c1(size_t i) { return reinterpret_cast<uint8 *>(arena_.get() + i * limbs_); }
+    [[nodiscard]] inline const uint8 *c1(size_t i) const {
+        return reinterpret_cast<const uint8 *>(arena_.get() + i * limbs_);
+    }
+
+    // Method to get the c2 value of ciphertext i, the c2 values of i + 1, ... follow it
+    inline uint8 *c2(size_t i) { return reinterpret_cast<uint8 *>(arena_.get() + (size_ + i) * limbs_); }
+    [[nodiscard]] inline const uint8 *c2(size_t i) const {
+        return reinterpret_cast<const uint8 *>(arena_.get() + (size_ + i) * limbs_);
+    }
+
+    // Methods to get the limbs of the c1 and c2 values of ciphertext i, for arithmetic on the arena
+    inline uint64 *c1_limbs(size_t i) { return arena_.get() + i * limbs_; }
+    [[nodiscard]] inline const uint64 *c1_limbs(size_t i) const { return arena_.get() + i * limbs_; }
+    inline uint64 *c2_limbs(size_t i) { return arena_.get() + (size_ + i) * limbs_; }
+    [[nodiscard]] inline const uint64 *c2_limbs(size_t i) const { return arena_.get() + (size_ + i) * limbs_; }
+
+    // Method to copy ciphertext j of src, whose values have the same size, into ciphertext i
+    inline void Copy(size_t i, const CiphertextArray &src, size_t j) {
+        std::memcpy(c1(i), src.c1(j), number_bytes());
+        std::memcpy(c2(i), src.c2(j), number_bytes());
+    }
+
+    // Method to convert ciphertext i into NTL numbers
+    inline void Get(size_t i, Ciphertext &dest) const {
+        NTL::ZZFromBytes(dest.first, c1(i), number_bytes());
+        NTL::ZZFromBytes(dest.second, c2(i), number_bytes());
+    }
+
+    // Method to store NTL numbers below 2^(8 * number_bytes()) as ciphertext i
+    inline void Set(size_t i, const Ciphertext &src) {
+        NTL::BytesFromZZ(c1(i), src.first, number_bytes());
+        NTL::BytesFromZZ(c2(i), src.second, number_bytes());
+    }
+
+    // Method to store ciphertext i from little-endian values of len bytes, len at most number_bytes()
+    void SetBytes(size_t i, const uint8 *c1_bytes, const uint8 *c2_bytes, uint32 len);
+
+    // Method to get the memory used by the arena
+    [[nodiscard]] inline uint64 bytes() const { return 2 * size_ * number_bytes(); }
+
+private:
+    // Struct to release the arena, unmaps it if it is a mapping of mapped_bytes
+    struct FreeArena {
+        size_t mapped_bytes;
+
+        void operator()(uint64 *p) const;
+    };
+
+    std::unique_ptr<uint64[], FreeArena> arena_;
+    size_t size_ = 0;
+    uint32 limbs_ = 0;
+};
+
+#endif // OTMPSI_CRYPTO_CIPHERTEXTARRAY_H_
@@ -0,0 +1,60 @@
+#ifndef OTMPSI_CRYPTO_DLOGTABLE_H_
+#define OTMPSI_CRYPTO_DLOGTABLE_H_
+
+#include <NTL/ZZ.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "utils/common.h"
+
+// Class for a discrete-log lookup table over products of a few bases.
+// For bases b_0 .. b_(m-1) and a factor limit k, the table holds every product b_(i_1) * ... * b_(i_s) mod p
+// with s <= k and i_1 <= ... <= i_s, keyed by a 64-bit fingerprint of the product. A lookup returns
+// the number of factors s and the largest index i_s. Products that share a fingerprint are marked
+// ambiguous and never match, so a caller can fall back to computing the logarithm
+class DlogTable {
+public:
+    // Struct for the factorization of one product
+    struct Entry {
+        uint8 factors; // number of factors s
+        uint8 max_index; // largest base index i_s, 0 for the empty product
+    };
+
+    // Default constructor, the table is empty until Build is called
+    DlogTable() = default;
+
+    // Default destructor
+    ~DlogTable() = default;
+
+    // Method to build the table for products of up to max_factors bases. Leaves the table empty and
+    // returns false when it would hold more than max_entries products
+    bool Build(const std::vector<NTL::ZZ> &bases, uint32 max_factors, const NTL::ZZ &p, uint64 max_entries);
+
+    // Method to drop the table
+    void Clear();
+
+    // Method to check if the table is built
+    [[nodiscard]] inline bool ready() const { return !table_.empty(); }
+
+    // Method to get the number of products in the table
+    [[nodiscard]] inline size_t size() const { return table_.size(); }
+
+    // Method to look up a product, returns false if it is not in the table
+    bool Lookup(const NTL::ZZ &x, Entry &entry) const;
+
+    // Method to count the products of up to max_factors of num_bases bases, saturating at limit + 1
+    static uint64 CountProducts(uint32 num_bases, uint32 max_factors, uint64 limit);
+
+private:
+    // Method to get the fingerprint of a number: its lowest 64 bits
+    static uint64 Fingerprint(const NTL::ZZ &x);
+
+    // Method to add the products whose remaining factors have indices of at least first_index
+    void Enumerate(const std::vector<NTL::ZZ> &bases, uint32 max_factors, const NTL::ZZ &p,
+                   const NTL::ZZ &product, Entry entry, uint32 first_index);
+
+    std::unordered_map<uint64, Entry> table_;
+};
+
+#endif // OTMPSI_CRYPTO_DLOGTABLE_H_
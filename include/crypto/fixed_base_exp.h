@@ -0,0 +1,50 @@
+#ifndef OTMPSI_CRYPTO_FIXEDBASEEXP_H_
+#define OTMPSI_CRYPTO_FIXEDBASEEXP_H_
+
+#include <NTL/ZZ.h>
+
+#include <vector>
+
+#include "utils/common.h"
+
+// Class for fixed-base modular exponentiation using precomputed window tables.
+// For a window width w the exponent is split into w-bit digits d_i, and the table stores
+// base^(d * 2^(w*i)) mod p for every non-zero digit d, so base^e is a product of one
+// table entry per window and needs no squarings at all.
+template<typename Backend>
+class FixedBaseExp {
+public:
+    typedef typename Backend::Number Number;
+
+    // Default constructor, the tables are empty until Precompute is called
+    FixedBaseExp() = default;
+
+    // Default destructor
+    ~FixedBaseExp() = default;
+
+    // Method to build the tables for exponents of up to max_exponent_bits bits
+    void Precompute(const Backend &backend, const Number &base, long max_exponent_bits, long window_bits);
+
+    // Method to drop the tables
+    void Clear();
+
+    // Method to check if the tables are built
+    [[nodiscard]] inline bool ready() const { return !table_.empty(); }
+
+    // Method to compute dest = base^exponent mod p
+    void PowerMod(const Backend &backend, Number &dest, const NTL::ZZ &exponent) const;
+
+    // Method to get the memory used by the tables
+    [[nodiscard]] uint64 TableBytes(const Backend &backend) const;
+
+private:
+    Number base_;
+    long window_bits_ = 0;
+    long max_exponent_bits_ = 0;
+    long num_windows_ = 0;
+
+    // table_[i * (2^w - 1) + d - 1] = base^(d * 2^(w*i)) mod p
+    std::vector<Number> table_;
+};
+
+#endif // OTMPSI_CRYPTO_FIXEDBASEEXP_H_
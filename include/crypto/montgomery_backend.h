@@ -0,0 +1,106 @@
+#ifndef OTMPSI_CRYPTO_MONTGOMERYBACKEND_H_
+#define OTMPSI_CRYPTO_MONTGOMERYBACKEND_H_
+
+#include <NTL/ZZ.h>
+#include <gmp.h>
+
+#include <cstddef>
+#include <string>
+
+#include "utils/common.h"
+
+// Arithmetic backend for the prime field p with a fixed number of 64-bit limbs. Numbers live in
+// Montgomery form x * R mod p with R = 2^(64 * Limbs) inside a fixed-size array, so no operation
+// allocates, and multiplications run on GMP's mpn_* kernels followed by a word-by-word
+// Montgomery reduction. See NtlBackend for the backend interface.
+//
+// The backend is explicitly instantiated for the moduli gen_prime produces with its default
+// q and q_power: 1248 bits (-sec 1024), 2272 bits (-sec 2048) and 3296 bits (-sec 3072).
+template<int Limbs>
+class MontgomeryBackend {
+public:
+    // Field element in Montgomery form, fully reduced below p
+    struct Number {
+        mp_limb_t limbs[Limbs];
+    };
+
+    // Number of limbs of a field element
+    static constexpr int kLimbs = Limbs;
+
+    // Delete the default constructor
+    MontgomeryBackend() = delete;
+
+    // Constructor that takes the modulus p, p must be odd and fit into Limbs limbs
+    explicit MontgomeryBackend(const NTL::ZZ &p);
+
+    // Default destructor
+    ~MontgomeryBackend() = default;
+
+    // Method to get the modulus
+    [[nodiscard]] inline const NTL::ZZ &modulus() const { return modulus_; }
+
+    // Method to convert an NTL::ZZ into a field element
+    void FromZz(Number &dest, const NTL::ZZ &src) const;
+
+    // Method to convert a field element into an NTL::ZZ
+    void ToZz(NTL::ZZ &dest, const Number &src) const;
+
+    // Method to set a field element to 1
+    inline void One(Number &dest) const { dest = one_; }
+
+    // Method to compute dest = a * b mod p
+    void MulMod(Number &dest, const Number &a, const Number &b) const;
+
+    // Method to compute dest = a^2 mod p
+    void SqrMod(Number &dest, const Number &a) const;
+
+    // Method to compute dest = base^exponent mod p, throws std::invalid_argument on a negative exponent
+    void PowerMod(Number &dest, const Number &base, const NTL::ZZ &exponent) const;
+
+    // Method to get the size of a field element in bytes
+    [[nodiscard]] inline long NumberBytes() const { return Limbs * sizeof(mp_limb_t); }
+
+    // Method to compute *dest[i] = *a[i] * *b[i] mod p for i < n. The products already run without
+    // allocating, so they are computed one by one
+    void BatchMulMod(Number *const *dest, const Number *const *a, const Number *const *b, size_t n) const;
+
+    // Method to compute *dest[i] = *base[i]^exponent mod p for i < n, one by one
+    void BatchPowerMod(Number *const *dest, const Number *const *base, const NTL::ZZ &exponent, size_t n) const;
+
+    // Method to compute dest[i] = a[i] * b[i] mod p for i < n on plain residues of limbs 64-bit limbs.
+    // Every product takes one more product with R^2 to bring a[i] into Montgomery form
+    void BatchMulModLimbs(uint64 *const *dest, const uint64 *const *a, const uint64 *const *b, size_t n,
+                          uint32 limbs) const;
+
+    // Method to compute dest[i] = base[i]^exponent mod p for i < n on plain residues of limbs 64-bit limbs
+    void BatchPowerModLimbs(uint64 *const *dest, const uint64 *const *base, const NTL::ZZ &exponent, size_t n,
+                            uint32 limbs) const;
+
+    // Method to pick the instruction set of the batched operations, this backend has none
+    inline void SetBatchIsa(const std::string &) {}
+
+    // Method to get the name of the instruction set of the batched operations
+    [[nodiscard]] inline const std::string &BatchIsa() const { return simdMulModNone; }
+
+private:
+    // Method to copy a plain residue of limbs limbs into dest, the limbs past Limbs are zero
+    static void LoadLimbs(Number &dest, const uint64 *src, uint32 limbs);
+
+    // Method to copy a plain residue into limbs limbs of dest, zero padded
+    static void StoreLimbs(uint64 *dest, const Number &src, uint32 limbs);
+
+    // Method to reduce a 2 * Limbs product t into dest = t / R mod p, t is clobbered
+    void Redc(Number &dest, mp_limb_t *t) const;
+
+    NTL::ZZ modulus_;
+    mp_limb_t p_[Limbs]; // modulus limbs
+    mp_limb_t p_inv_; // -p^-1 mod 2^64
+    Number one_; // R mod p, i.e. 1 in Montgomery form
+    Number r2_; // R^2 mod p, used to enter Montgomery form
+};
+
+// Function to get the number of limbs of the Montgomery backend instantiated for a modulus
+// of the given size, 0 if there is none
+int MontgomeryLimbsForBits(long modulus_bits);
+
+#endif // OTMPSI_CRYPTO_MONTGOMERYBACKEND_H_
@@ -0,0 +1,100 @@
+#ifndef OTMPSI_CRYPTO_NTLBACKEND_H_
+#define OTMPSI_CRYPTO_NTLBACKEND_H_
+
+#include <NTL/ZZ.h>
+
+#include <cstddef>
+#include <string>
+
+#include "crypto/simd_mul_mod.h"
+
+// Arithmetic backend for the prime field p built on NTL::ZZ. This is the reference backend,
+// numbers are plain residues in [0, p).
+//
+// An arithmetic backend provides a Number type and the following operations on it:
+//   FromZz / ToZz           conversion from and to NTL::ZZ residues
+//   One                     the neutral element
+//   MulMod / SqrMod         modular multiplication and squaring
+//   PowerMod                modular exponentiation with a non-negative NTL::ZZ exponent
+//   NumberBytes             the size of a field element in bytes
+//   BatchMulMod             n independent multiplications on pointer arrays
+//   BatchPowerMod           n exponentiations with a common small exponent on pointer arrays
+//   BatchMulModLimbs        BatchMulMod on plain residues of 64-bit limbs, such as CiphertextArray values
+//   BatchPowerModLimbs      BatchPowerMod on plain residues of 64-bit limbs
+//   SetBatchIsa / BatchIsa  the instruction set of the batched operations, see SimdMulMod
+class NtlBackend {
+public:
+    typedef NTL::ZZ Number;
+
+    // Delete the default constructor
+    NtlBackend() = delete;
+
+    // Constructor that takes the modulus p
+    explicit NtlBackend(const NTL::ZZ &p) : p_(p), simd_(p) {};
+
+    // Default destructor
+    ~NtlBackend() = default;
+
+    // Method to get the modulus
+    [[nodiscard]] inline const NTL::ZZ &modulus() const { return p_; }
+
+    // Method to convert an NTL::ZZ into a field element
+    inline void FromZz(Number &dest, const NTL::ZZ &src) const { dest = src % p_; }
+
+    // Method to convert a field element into an NTL::ZZ
+    inline void ToZz(NTL::ZZ &dest, const Number &src) const { dest = src; }
+
+    // Method to set a field element to 1
+    inline void One(Number &dest) const { dest = 1; }
+
+    // Method to compute dest = a * b mod p
+    inline void MulMod(Number &dest, const Number &a, const Number &b) const { NTL::MulMod(dest, a, b, p_); }
+
+    // Method to compute dest = a^2 mod p
+    inline void SqrMod(Number &dest, const Number &a) const { NTL::SqrMod(dest, a, p_); }
+
+    // Method to compute dest = base^exponent mod p
+    inline void PowerMod(Number &dest, const Number &base, const NTL::ZZ &exponent) const {
+        NTL::PowerMod(dest, base, exponent, p_);
+    }
+
+    // Method to get the size of a field element in bytes
+    [[nodiscard]] inline long NumberBytes() const { return (NTL::NumBits(p_) + 7) / 8; }
+
+    // Method to compute *dest[i] = *a[i] * *b[i] mod p for i < n, eight at a time on SIMD lanes
+    inline void BatchMulMod(Number *const *dest, const Number *const *a, const Number *const *b, size_t n) const {
+        simd_.MulMod(dest, a, b, n);
+    }
+
+    // Method to compute *dest[i] = *base[i]^exponent mod p for i < n, eight at a time on SIMD lanes
+    inline void BatchPowerMod(Number *const *dest, const Number *const *base, const NTL::ZZ &exponent,
+                              size_t n) const {
+        simd_.PowerMod(dest, base, exponent, n);
+    }
+
+    // Method to compute dest[i] = a[i] * b[i] mod p for i < n on plain residues of limbs 64-bit limbs,
+    // eight at a time on SIMD lanes
+    inline void BatchMulModLimbs(uint64 *const *dest, const uint64 *const *a, const uint64 *const *b, size_t n,
+                                 uint32 limbs) const {
+        simd_.MulMod(dest, a, b, n, limbs);
+    }
+
+    // Method to compute dest[i] = base[i]^exponent mod p for i < n on plain residues of limbs 64-bit limbs,
+    // eight at a time on SIMD lanes
+    inline void BatchPowerModLimbs(uint64 *const *dest, const uint64 *const *base, const NTL::ZZ &exponent,
+                                   size_t n, uint32 limbs) const {
+        simd_.PowerMod(dest, base, exponent, n, limbs);
+    }
+
+    // Method to pick the instruction set of the batched operations by name
+    inline void SetBatchIsa(const std::string &isa) { simd_ = SimdMulMod(p_, isa); }
+
+    // Method to get the name of the instruction set of the batched operations
+    [[nodiscard]] inline const std::string &BatchIsa() const { return simd_.isa(); }
+
+private:
+    NTL::ZZ p_;
+    SimdMulMod simd_;
+};
+
+#endif // OTMPSI_CRYPTO_NTLBACKEND_H_
@@ -0,0 +1,113 @@
+#ifndef OTMPSI_CRYPTO_SIMDMULMOD_H_
+#define OTMPSI_CRYPTO_SIMDMULMOD_H_
+
+#include <NTL/ZZ.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "utils/common.h"
+
+// Largest modulus the SIMD kernels take, larger moduli loop over NTL
+const long simdMaxModulusBits = 4096;
+
+// Largest exponent SimdMulMod::PowerMod runs on the SIMD kernels, larger ones loop over NTL
+const long simdMaxExponentBits = 32;
+
+// Class for modular multiplications of independent operands, eight at a time with one per SIMD lane.
+// A batch is transposed into digit-major vectors, digit d of lane l at [d * kLanes + l], with 52-bit
+// digits for AVX-512 IFMA or 26-bit digits for AVX2, and multiplied with a lane-parallel Montgomery
+// reduction. Every Montgomery product leaves a factor R^-1, which one more product with a power of R
+// removes at the end, so operands and results are plain residues in [0, p) like NtlBackend's. If the
+// CPU lacks the requested instruction set, or the modulus is beyond simdMaxModulusBits, the methods
+// loop over NTL. The overloads on limbs take residues as they are stored in a CiphertextArray and loop
+// over GMP's mpn_* functions instead, so their operands are never converted into NTL numbers
+class SimdMulMod {
+public:
+    // Number of independent products computed at once
+    static constexpr int kLanes = 8;
+
+    // Delete the default constructor
+    SimdMulMod() = delete;
+
+    // Constructor that takes the modulus p and the name of the instruction set. simdMulModAuto picks
+    // AVX-512 IFMA when the CPU has it and NTL otherwise, the AVX2 kernel is slower than GMP on the
+    // moduli of the protocol and is only used when asked for. Even moduli loop over NTL
+    explicit SimdMulMod(const NTL::ZZ &p, const std::string &isa = simdMulModAuto);
+
+    // Default destructor
+    ~SimdMulMod() = default;
+
+    // Method to get the name of the instruction set in use: avx512ifma, avx2 or none
+    [[nodiscard]] const std::string &isa() const;
+
+    // Method to compute *dest[i] = *a[i] * *b[i] mod p for i < n, dest[i] may be a[i] or b[i]
+    void MulMod(NTL::ZZ *const *dest, const NTL::ZZ *const *a, const NTL::ZZ *const *b, size_t n) const;
+
+    // Method to compute *dest[i] = *base[i]^exponent mod p for i < n, dest[i] may be base[i]. Meant for
+    // small exponents such as q, negative exponents and those of more than simdMaxExponentBits bits loop over NTL
+    void PowerMod(NTL::ZZ *const *dest, const NTL::ZZ *const *base, const NTL::ZZ &exponent, size_t n) const;
+
+    // Method to compute dest[i] = a[i] * b[i] mod p for i < n on residues of limbs little-endian 64-bit
+    // limbs, dest[i] may be a[i] or b[i]. Throws std::invalid_argument if p does not fit into limbs limbs
+    void MulMod(uint64 *const *dest, const uint64 *const *a, const uint64 *const *b, size_t n, uint32 limbs) const;
+
+    // Method to compute dest[i] = base[i]^exponent mod p for i < n on residues of limbs little-endian 64-bit
+    // limbs, dest[i] may be base[i]. Throws std::invalid_argument on a negative exponent
+    void PowerMod(uint64 *const *dest, const uint64 *const *base, const NTL::ZZ &exponent, size_t n,
+                  uint32 limbs) const;
+
+private:
+    // Instruction sets of the kernels
+    enum class Isa {
+        none,
+        avx2,
+        avx512ifma
+    };
+
+    // Methods to run the kernels on n residues of type T, NTL::ZZ or limbs limbs of uint64
+    template<typename T>
+    void MulModLanes(T *const *dest, const T *const *a, const T *const *b, size_t n, uint32 limbs) const;
+    template<typename T>
+    void PowerModLanes(T *const *dest, const T *const *base, const NTL::ZZ &exponent, size_t n, uint32 limbs) const;
+
+    // Methods to transpose count residues into the lanes of dest, the other lanes are zeroed. words is
+    // scratch space of ScratchWords(limbs) words
+    void Load(uint64 *dest, const NTL::ZZ *const *src, size_t count, uint32 limbs, uint64 *words) const;
+    void Load(uint64 *dest, const uint64 *const *src, size_t count, uint32 limbs, uint64 *words) const;
+
+    // Methods to transpose count lanes of src, which are below 2p, back into residues
+    void Store(NTL::ZZ *const *dest, const uint64 *src, size_t count, uint32 limbs, uint64 *words) const;
+    void Store(uint64 *const *dest, const uint64 *src, size_t count, uint32 limbs, uint64 *words) const;
+
+    // Method to get the scratch words of Load and Store, room for the digits of a number or limbs limbs
+    // and the 8 bytes past them that SplitDigits and JoinDigits touch
+    [[nodiscard]] size_t ScratchWords(uint32 limbs) const;
+
+    // Method to compute dest = a * b mod p on residues of limbs limbs with GMP, t is scratch space of
+    // 3 * limbs + 1 limbs. dest may be a or b
+    void MulModMpn(uint64 *dest, const uint64 *a, const uint64 *b, uint32 limbs, uint64 *t) const;
+
+    // Method to throw unless p fits into residues of limbs limbs
+    void CheckLimbs(uint32 limbs) const;
+
+    // Method to set every lane of dest to R^r_power mod p
+    void Broadcast(uint64 *dest, long r_power) const;
+
+    // Method to compute the Montgomery products dest = a * b / R mod p of all lanes, for operands
+    // below 2p with results below 2p. dest may be a or b
+    void MontMul(uint64 *dest, const uint64 *a, const uint64 *b) const;
+
+    NTL::ZZ p_;
+    Isa isa_;
+    int radix_ = 0; // bits per digit
+    int digits_ = 0; // digits per number, R = 2^(radix_ * digits_) > 4p
+    long bytes_ = 0; // bytes covering the digits of a number
+    uint64 k0_ = 0; // -p^-1 mod 2^radix_
+    std::vector<uint64> p_digits_; // digits of p
+    std::vector<uint64> r2_; // R^2 mod p in every lane, removes the R^-1 of a single product
+    std::vector<uint64> p_limbs_; // limbs of p, without leading zero limbs
+};
+
+#endif // OTMPSI_CRYPTO_SIMDMULMOD_H_
@@ -3,41 +3,63 @@
 
 #include <NTL/ZZ.h>
 
+#include <cstddef>
+#include <string>
 #include <utility>
 #include <vector>
 
-// Define a Ciphertext type as a pair of ZZ values
-typedef std::pair<NTL::ZZ, NTL::ZZ> Ciphertext;
+#include "crypto/chacha_stream.h"
+#include "crypto/fixed_base_exp.h"
+#include "crypto/montgomery_backend.h"
+#include "crypto/ntl_backend.h"
 
-// KeyHolder class for threshold ElGamal encryption
-class KeyHolder {
+class CiphertextArray;
+
+// Define a ciphertext as a pair of field elements of an arithmetic backend
+template<typename Backend>
+using BasicCiphertext = std::pair<typename Backend::Number, typename Backend::Number>;
+
+// KeyHolder class for threshold ElGamal encryption over an arithmetic backend
+template<typename Backend>
+class BasicKeyHolder {
 public:
+    typedef typename Backend::Number Number;
+    typedef BasicCiphertext<Backend> Ciphertext;
+
     // Delete the default constructor
-    KeyHolder() = delete;
+    BasicKeyHolder() = delete;
 
     // Constructor that takes the public parameters p and alpha, and a list of prime factors of p-1
-    KeyHolder(const NTL::ZZ &p, const NTL::ZZ &alpha, std::vector<NTL::ZZ> p_prime_factor_list)
-            : p_(p), alpha_(alpha), phi_p_prime_factor_list_(std::move(p_prime_factor_list)) {
+    BasicKeyHolder(const NTL::ZZ &p, const NTL::ZZ &alpha, std::vector<NTL::ZZ> p_prime_factor_list)
+            : backend_(p), p_(p), phi_p_prime_factor_list_(std::move(p_prime_factor_list)) {
         // Generate a random secret key a
-        NTL::RandomBnd(a_, p);
+        ChaChaStream &random = ChaChaStream::ThreadLocal();
+        random.RandomBnd(a_, p);
         while (a_ < 1) {
-            NTL::RandomBnd(a_, p - 1);
+            random.RandomBnd(a_, p - 1);
         }
+        // Decryption shares use c1^(p-1-a) = c1^(-a), which keeps all exponents non-negative
+        neg_a_ = p - 1 - a_;
         // Compute the public key beta = alpha^a mod p
-        NTL::PowerMod(beta_, alpha, a_, p);
+        backend_.FromZz(alpha_, alpha);
+        backend_.PowerMod(beta_, alpha_, a_);
+        backend_.One(one_);
     }
 
     // Default destructor
-    ~KeyHolder() = default;
+    ~BasicKeyHolder() = default;
+
+    // Method to get the arithmetic backend
+    [[nodiscard]] inline const Backend &backend() const { return backend_; }
 
     // Method to encrypt a plaintext message
-    void Encrypt(Ciphertext &ciphertext, const NTL::ZZ &plaintext);
+    void Encrypt(Ciphertext &ciphertext, const Number &plaintext);
 
     // Method to fully decrypt a ciphertext using decryption shares from multiple key holders
-    void FullyDecrypt(NTL::ZZ &plaintext, const std::vector<NTL::ZZ> &decryption_shares, const NTL::ZZ &c2);
+    void FullyDecrypt(Number &plaintext, const std::vector<Number> &decryption_shares, const Number &c2);
 
     // Method to partially decrypt a ciphertext and produce a decryption share
-    inline void PartialDecrypt(NTL::ZZ &decryption_share, const NTL::ZZ &c1);
+    inline void PartialDecrypt(Number &decryption_share, const Number &c1);
 
     // Method to exponentiate a ciphertext
     inline void Power(Ciphertext &dest, const Ciphertext &src, const NTL::ZZ &exponent);
@@ -45,48 +67,123 @@ public:
     // Method to multiply two ciphertexts
     inline void Mul(Ciphertext &dest, const Ciphertext &src1, const Ciphertext &src2);
 
+    // Method to multiply n pairs of ciphertexts, dest[i] = src1[i] * src2[i], dest may be src1 or src2.
+    // The backend gets all 2n products as one batch
+    void MulBatch(Ciphertext *dest, const Ciphertext *src1, const Ciphertext *src2, size_t n);
+
+    // Method to multiply n pairs of ciphertexts given by pointers, *dest[i] = *src1[i] * *src2[i]
+    void MulBatch(Ciphertext *const *dest, const Ciphertext *const *src1, const Ciphertext *const *src2, size_t n);
+
+    // Method to exponentiate n ciphertexts given by pointers with a common small exponent such as q,
+    // dest[i] may be src[i]. The backend gets all 2n exponentiations as one batch
+    void PowerBatch(Ciphertext *const *dest, const Ciphertext *const *src, const NTL::ZZ &exponent, size_t n);
+
+    // Method to multiply n ciphertexts of arrays in place on their limbs, ciphertext dest_index[i] of dest by
+    // ciphertext src_index[i] of src. The arrays must have values of the same size, and a batch must not
+    // name a ciphertext of dest twice
+    void MulBatch(CiphertextArray &dest, const size_t *dest_index, const CiphertextArray &src,
+                  const size_t *src_index, size_t n);
+
+    // Method to exponentiate n ciphertexts of an array in place on their limbs with a common small exponent
+    void PowerBatch(CiphertextArray &array, const size_t *index, const NTL::ZZ &exponent, size_t n);
+
     // Method to find square root of a ciphertext. The function assigns src to dest if src is not a square in the finite field
     void SquareRoot(Ciphertext &dest, const Ciphertext &src);
 
     // Method to rerandomize a ciphertext
     inline void ReRand(Ciphertext &dest, const Ciphertext &src);
 
+    // Method to install a pool of encryptions of 1. From then on EncryptOne multiplies subset_size
+    // distinct pool entries picked at random instead of encrypting, see README for the security level.
+    // An empty pool or a subset size of 0 turns it off
+    void SetRerandomizerPool(std::vector<Ciphertext> pool, uint32 subset_size);
+
+    // Method to produce a fresh encryption of 1, from the rerandomizer pool when one is installed
+    void EncryptOne(Ciphertext &ciphertext);
+
+    // Method to replace the secret key, the public key becomes the local share alpha^a
+    void SetSecretKey(const NTL::ZZ &a);
+
+    // Method to get the secret key, for persisting it
+    [[nodiscard]] inline const NTL::ZZ &secret_key() const { return a_; }
+
+    // Method to use short random exponents of the given length in Encrypt, bits = 0 draws them below p.
+    // Exponents of b bits leave roughly (b - log2(smooth part of p-1)) / 2 bits of security, see README
+    void SetShortExponentBits(long bits);
+
+    // Method to build the fixed-base tables for alpha and beta, window_bits = 0 disables them.
+    // Call after SetShortExponentBits so the tables only cover the exponents in use
+    void PrecomputeFixedBases(long window_bits);
+
+    // Method to get the memory used by the fixed-base tables
+    [[nodiscard]] uint64 FixedBaseTableBytes() const;
+
+    // Method to pick the instruction set of MulBatch and PowerBatch by name, see SimdMulMod
+    inline void SetBatchIsa(const std::string &isa) { backend_.SetBatchIsa(isa); }
+
 protected:
+    // Arithmetic backend holding the modulus
+    Backend backend_;
+
     // Public parameters
     NTL::ZZ p_;
-    NTL::ZZ alpha_;
-    NTL::ZZ beta_;
+    Number alpha_;
+    Number beta_;
+    Number one_;
     std::vector<NTL::ZZ> phi_p_prime_factor_list_;
 
+    // Fixed-base exponentiation tables for alpha and beta, built once beta is fixed
+    FixedBaseExp<Backend> alpha_table_;
+    FixedBaseExp<Backend> beta_table_;
+
+    // Length of the random exponents drawn by Encrypt, 0 for exponents below p
+    long short_exponent_bits_ = 0;
+
+    // Encryptions of 1 combined by EncryptOne, and the number of them in each product
+    std::vector<Ciphertext> rerand_pool_;
+    uint32 rerand_subset_size_ = 0;
+
+    // Method to draw the random exponent of an encryption
+    void RandomExponent(NTL::ZZ &random_num);
+
     // Method to check if a number is coprime with p
     bool CoprimeWithPhiP(const NTL::ZZ &k);
 
 private:
     // Secret key
     NTL::ZZ a_;
+    NTL::ZZ neg_a_;
 };
 
+// The protocol runs on NTL, the reference backend
+typedef BasicKeyHolder<NtlBackend> KeyHolder;
+typedef KeyHolder::Ciphertext Ciphertext;
+
 // Method to partially decrypt a ciphertext and produce a decryption share
-void KeyHolder::PartialDecrypt(NTL::ZZ &decryption_share, const NTL::ZZ &c1) {
-    NTL::PowerMod(decryption_share, c1, -a_, p_);
+template<typename Backend>
+void BasicKeyHolder<Backend>::PartialDecrypt(Number &decryption_share, const Number &c1) {
+    backend_.PowerMod(decryption_share, c1, neg_a_);
 }
 
 // Method to exponentiate a ciphertext
-void KeyHolder::Power(Ciphertext &dest, const Ciphertext &src, const NTL::ZZ &exponent) {
-    NTL::PowerMod(dest.first, src.first, exponent, p_);
-    NTL::PowerMod(dest.second, src.second, exponent, p_);
+template<typename Backend>
+void BasicKeyHolder<Backend>::Power(Ciphertext &dest, const Ciphertext &src, const NTL::ZZ &exponent) {
+    backend_.PowerMod(dest.first, src.first, exponent);
+    backend_.PowerMod(dest.second, src.second, exponent);
 }
 
 // Method to multiply two ciphertexts
-void KeyHolder::Mul(Ciphertext &dest, const Ciphertext &src1, const Ciphertext &src2) {
-    NTL::MulMod(dest.first, src1.first, src2.first, p_);
-    NTL::MulMod(dest.second, src1.second, src2.second, p_);
+template<typename Backend>
+void BasicKeyHolder<Backend>::Mul(Ciphertext &dest, const Ciphertext &src1, const Ciphertext &src2) {
+    backend_.MulMod(dest.first, src1.first, src2.first);
+    backend_.MulMod(dest.second, src1.second, src2.second);
 }
 
 // Method to rerandomize a ciphertext
-void KeyHolder::ReRand(Ciphertext &dest, const Ciphertext &src) {
+template<typename Backend>
+void BasicKeyHolder<Backend>::ReRand(Ciphertext &dest, const Ciphertext &src) {
     Ciphertext r;
-    Encrypt(r, NTL::ZZ(1));
+    EncryptOne(r);
     Mul(dest, src, r);
 }
 
@@ -2,9 +2,23 @@
 #define OTMPSI_NETWORK_ENDPOINT_H_
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "utils/common.h"
 
+// Define a read-only buffer (data, length) for scatter-gather writes
+typedef std::pair<const void *, uint32> ConstBuffer;
+
+// Limit of channels resolved per endpoint. The tables of resolved channels are reserved up front,
+// so GetChannel does not move them while other channels are in use
+const uint32 maxResolvedChannels = 1024;
+
+// Define a handle to a channel of an endpoint, resolved once from the remote name with GetChannel
+struct ChannelHandle {
+    uint32 index;
+};
+
 // Abstract base class for network endpoints
 class Endpoint {
 public:
@@ -30,8 +44,32 @@ public:
     // Method to write data to a remote endpoint
     virtual void Write(const std::string &remote_name, const void *buf, uint32 len) = 0;
 
-    // Method to asynchronously write data to a remote endpoint
-    virtual void AsyncWrite(const std::string &remote_name, void *buf, uint32 len) = 0;
+    // Method to write several buffers to a remote endpoint with a single gathered write
+    virtual void Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) = 0;
+
+    // Method to resolve the channel of a connected remote endpoint into a handle. Handles stay
+    // valid until the endpoint is stopped, and resolving may run while other channels are in use
+    virtual ChannelHandle GetChannel(const std::string &remote_name) = 0;
+
+    // Method to write data to a channel
+    virtual void Write(ChannelHandle channel, const void *buf, uint32 len) = 0;
+
+    // Method to write several buffers to a channel with a single gathered write
+    virtual void Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) = 0;
+
+    // Method to take a send buffer of len bytes for AsyncWrite on a channel
+    virtual std::vector<uint8> AcquireBuffer(ChannelHandle channel, uint32 len) = 0;
+
+    // Method to asynchronously write a buffer to a channel. The endpoint owns the buffer until
+    // the write completes, and the call blocks while too many bytes are in flight on the channel
+    virtual void AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) = 0;
+
+    // Method to wait until all asynchronous writes on a channel have completed
+    virtual void Flush(ChannelHandle channel) = 0;
+
+    // Method to read data from a channel
+    virtual void Read(ChannelHandle channel, void *buf, uint32 len) = 0;
+
 
     // Method to read data from a remote endpoint
     virtual void Read(const std::string &remote_name, void *buf, uint32 len) = 0;
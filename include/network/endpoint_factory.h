@@ -0,0 +1,15 @@
+#ifndef OTMPSI_NETWORK_ENDPOINTFACTORY_H_
+#define OTMPSI_NETWORK_ENDPOINTFACTORY_H_
+
+#include <memory>
+
+#include "network/endpoint.h"
+#include "utils/common.h"
+
+// Function to create the network endpoint selected by options.network_backend, listening on options.port
+std::unique_ptr<Endpoint> NewEndpointFromOptions(const Options &options);
+
+// Function to wrap an endpoint into a MuxEndpoint when options.connections_per_peer is set
+std::unique_ptr<Endpoint> MultiplexEndpoint(std::unique_ptr<Endpoint> endpoint, const Options &options);
+
+#endif // OTMPSI_NETWORK_ENDPOINTFACTORY_H_
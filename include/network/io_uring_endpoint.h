@@ -0,0 +1,147 @@
+#ifndef OTMPSI_NETWORK_IOURINGENDPOINT_H_
+#define OTMPSI_NETWORK_IOURINGENDPOINT_H_
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "network/tcp_endpoint.h"
+
+const uint32 ioUringEntries = 256;
+const uint32 ioUringFixedFiles = 1024;
+const uint32 zeroCopyMinBytes = 16 << 10;
+
+// Struct for one send or receive handed to the io_uring thread
+struct IoUringRequest {
+    bool send;
+    uint32 channel;
+    std::vector<iovec> iov; // data still to transfer starts at iov[iov_offset]
+    size_t iov_offset = 0;
+    msghdr msg{};
+    bool zero_copy = false; // issued as SEND_ZC/SENDMSG_ZC
+    uint32 pending_notifications = 0; // zero-copy buffers the kernel still references
+    bool transferred = false;
+    int result = 0;
+
+    // an asynchronous send owns its buffer, a synchronous caller waits on done
+    bool async = false;
+    std::vector<uint8> owned;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+};
+
+// Struct for the io_uring state of a channel
+struct IoUringChannel {
+    int fd; // registered file index when fixed_file is set, socket descriptor otherwise
+    bool fixed_file;
+    bool shared_memory;
+    std::deque<IoUringRequest *> sends; // sends of the channel in order, the front one is in the ring
+    std::atomic<uint64> in_flight_bytes{0};
+};
+
+// Class for a TCP endpoint whose channel traffic goes through one io_uring instance.
+// Connections are set up by TcpEndpoint. Afterwards the sends and receives of all channels are
+// handed to an io thread, which submits everything queued since its last wake-up with one
+// io_uring_enter call. Sockets are registered files, and large sends can use zero-copy SEND_ZC.
+// Sends of a channel are issued one after another so the byte stream keeps its order
+class IoUringEndpoint : public TcpEndpoint {
+public:
+    // Delete the default constructor
+    IoUringEndpoint() = delete;
+
+    // Constructor that takes a port number, the limit of queued bytes per channel and whether to send
+    // payloads of at least zeroCopyMinBytes with zero copy. Throws if io_uring is not available
+    IoUringEndpoint(int port, uint64 max_in_flight_bytes, bool zero_copy);
+
+    // Destructor that stops the io thread and unmaps the rings
+    ~IoUringEndpoint() override;
+
+    // Method to stop the endpoint
+    void Stop() override;
+
+    // Method to resolve the channel of a connected remote endpoint into a handle
+    ChannelHandle GetChannel(const std::string &remote_name) override;
+
+    // Method to write data to a channel
+    void Write(ChannelHandle channel, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a channel with a single gathered send
+    void Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to take a send buffer of len bytes for AsyncWrite on a channel
+    std::vector<uint8> AcquireBuffer(ChannelHandle channel, uint32 len) override;
+
+    // Method to asynchronously write a buffer to a channel, blocks while the bytes in flight exceed the limit
+    void AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) override;
+
+    // Method to wait until all asynchronous writes on a channel have completed
+    void Flush(ChannelHandle channel) override;
+
+    // Method to read data from a channel
+    void Read(ChannelHandle channel, void *buf, uint32 len) override;
+
+private:
+    // Method to hand a request to the io thread
+    void Submit(IoUringRequest *request);
+
+    // Method to hand a synchronous request to the io thread and wait for it, returns false on error
+    bool SubmitAndWait(IoUringRequest &request);
+
+    // Main loop of the io thread
+    void Run();
+
+    // Method to queue a request on its channel, and issue it if nothing is ahead of it
+    void Enqueue(IoUringRequest *request);
+
+    // Method to put the next transfer of a request into the submission queue
+    void Issue(IoUringRequest *request);
+
+    // Method to take a free submission queue entry, submitting the queued ones if the ring is full
+    struct io_uring_sqe *NextSqe();
+
+    // Method to arm the read on the wake-up eventfd
+    void ArmWakeup();
+
+    // Method to handle one completion
+    void HandleCompletion(uint64 user_data, int res, uint32 flags);
+
+    // Method to finish a request once its data is transferred and the kernel released its buffer
+    void MaybeFinish(IoUringRequest *request);
+
+    int ring_fd_ = -1;
+    int wake_fd_ = -1;
+    uint64 wake_value_ = 0;
+    bool zero_copy_;
+    bool fixed_files_ = false;
+
+    // mappings of the submission and completion rings
+    void *sq_ptr_ = nullptr;
+    size_t sq_bytes_ = 0;
+    void *cq_ptr_ = nullptr;
+    size_t cq_bytes_ = 0;
+    struct io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_bytes_ = 0;
+    uint32 *sq_head_, *sq_tail_, *sq_array_, *cq_head_, *cq_tail_;
+    uint32 sq_mask_, sq_entries_, cq_mask_;
+    struct io_uring_cqe *cqes_;
+    uint32 to_submit_ = 0;
+
+    std::vector<std::unique_ptr<IoUringChannel>> uring_channels_; // indexed by ChannelHandle::index
+    BufferPool pool_;
+
+    std::thread io_thread_;
+    std::mutex incoming_mtx_;
+    std::vector<IoUringRequest *> incoming_;
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> stopping_{false};
+};
+
+#endif // OTMPSI_NETWORK_IOURINGENDPOINT_H_
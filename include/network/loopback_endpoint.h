@@ -0,0 +1,177 @@
+#ifndef OTMPSI_NETWORK_LOOPBACKENDPOINT_H_
+#define OTMPSI_NETWORK_LOOPBACKENDPOINT_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "endpoint.h"
+#include "utils/buffer_pool.h"
+#include "utils/spsc_byte_queue.h"
+
+const size_t defaultLoopbackQueueBytes = 1 << 18;
+
+class LoopbackEndpoint;
+
+// Class for the registry of the loopback endpoints of one process. Endpoints are found by
+// the port of their address, so the usual configuration files work unchanged
+class LoopbackNetwork {
+public:
+    // Constructor that takes the capacity of every channel direction in bytes
+    explicit LoopbackNetwork(size_t queue_bytes = defaultLoopbackQueueBytes) : queue_bytes_(queue_bytes) {};
+
+    // Default destructor
+    ~LoopbackNetwork() = default;
+
+    // Method to register an endpoint listening on a port
+    void Register(uint32 port, LoopbackEndpoint *endpoint);
+
+    // Method to remove the endpoint listening on a port
+    void Unregister(uint32 port);
+
+    // Method to find the endpoint listening on a port, nullptr if there is none
+    LoopbackEndpoint *Find(uint32 port);
+
+    // Method to get the capacity of every channel direction in bytes
+    [[nodiscard]] inline size_t queue_bytes() const { return queue_bytes_; }
+
+private:
+    size_t queue_bytes_;
+    std::mutex mtx_;
+    std::unordered_map<uint32, LoopbackEndpoint *> endpoints_;
+};
+
+// Struct for one side of an in-memory channel
+struct LoopbackChannel {
+    std::shared_ptr<SpscByteQueue> in;
+    std::shared_ptr<SpscByteQueue> out;
+};
+
+// Class for an endpoint whose channels are in-memory byte queues to endpoints of the same process.
+// Like a TCP channel, every channel must be written by one thread and read by one thread
+class LoopbackEndpoint : public Endpoint {
+public:
+    // Delete the default constructor
+    LoopbackEndpoint() = delete;
+
+    // Constructor that takes the network to join and the port to listen on
+    LoopbackEndpoint(LoopbackNetwork &network, uint32 port) : network_(network), port_(port) {
+        resolved_channels_.reserve(maxResolvedChannels);
+        network_.Register(port_, this);
+    };
+
+    // Destructor that leaves the network
+    ~LoopbackEndpoint() override { network_.Unregister(port_); };
+
+    // Method to start the endpoint
+    void Start() override { accept_flag_ = true; };
+
+    // Method to stop the endpoint
+    void Stop() override;
+
+    // Method to stop listen
+    void StopListen() override { accept_flag_ = false; };
+
+    // Method to connect to a remote endpoint
+    void
+    Connect(const std::string &remote_name, const std::string &remote_address, const std::string &local_name) override;
+
+    // Method to close a connection with a remote endpoint
+    void CloseChannel(const std::string &remote_name) override;
+
+    // Method to write data to a remote endpoint
+    void Write(const std::string &remote_name, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a remote endpoint
+    void Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to read data from a remote endpoint
+    void Read(const std::string &remote_name, void *buf, uint32 len) override;
+
+    // Method to resolve the channel of a connected remote endpoint into a handle
+    ChannelHandle GetChannel(const std::string &remote_name) override;
+
+    // Method to write data to a channel
+    inline void Write(ChannelHandle channel, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a channel
+    inline void Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to take a send buffer of len bytes for AsyncWrite on a channel
+    inline std::vector<uint8> AcquireBuffer(ChannelHandle channel, uint32 len) override;
+
+    // Method to write a buffer to a channel, the copy into the queue completes before returning
+    inline void AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) override;
+
+    // Method to wait until all asynchronous writes on a channel have completed, nothing to wait for here
+    void Flush(ChannelHandle channel) override {};
+
+    // Method to read data from a channel
+    inline void Read(ChannelHandle channel, void *buf, uint32 len) override;
+
+    // Method to get the names of all connected remote endpoints
+    std::vector<std::string> GetRemoteNames() override;
+
+    // Method to get the total amount of data sent
+    uint64 GetTotalBytesSent() const override { return total_bytes_sent_; };
+
+    // Method to get the total amount of data received
+    uint64 GetTotalBytesReceived() const override { return total_bytes_received_; };
+
+    // Method to reset the total amount of data sent and received
+    void ResetCounters() override;
+
+private:
+    // Method to add a channel opened by a remote endpoint, returns false when not listening
+    bool Accept(const std::string &remote_name, const LoopbackChannel &channel);
+
+    // Method to find the channel of a remote endpoint by name
+    LoopbackChannel &FindChannel(const std::string &remote_name);
+
+    LoopbackNetwork &network_;
+    uint32 port_;
+    std::atomic<bool> accept_flag_{false};
+
+    std::mutex mtx_; // guards channels_ against concurrent connects
+    std::unordered_map<std::string, LoopbackChannel> channels_;
+    std::vector<LoopbackChannel> resolved_channels_; // indexed by ChannelHandle::index
+    BufferPool pool_;
+
+    std::atomic<uint64> total_bytes_sent_{0};
+    std::atomic<uint64> total_bytes_received_{0};
+};
+
+// Method to write data to a channel
+void LoopbackEndpoint::Write(ChannelHandle channel, const void *buf, uint32 len) {
+    resolved_channels_[channel.index].out->Write(buf, len);
+    total_bytes_sent_ += len;
+}
+
+// Method to write several buffers to a channel
+void LoopbackEndpoint::Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) {
+    for (const auto &b: buffers) {
+        Write(channel, b.first, b.second);
+    }
+}
+
+// Method to take a send buffer of len bytes for AsyncWrite on a channel
+std::vector<uint8> LoopbackEndpoint::AcquireBuffer(ChannelHandle channel, uint32 len) {
+    return pool_.Acquire(len);
+}
+
+// Method to write a buffer to a channel, the copy into the queue completes before returning
+void LoopbackEndpoint::AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) {
+    Write(channel, buf.data(), buf.size());
+    pool_.Release(std::move(buf));
+}
+
+// Method to read data from a channel
+void LoopbackEndpoint::Read(ChannelHandle channel, void *buf, uint32 len) {
+    resolved_channels_[channel.index].in->Read(buf, len);
+    total_bytes_received_ += len;
+}
+
+#endif // OTMPSI_NETWORK_LOOPBACKENDPOINT_H_
@@ -0,0 +1,176 @@
+#ifndef OTMPSI_NETWORK_MUXENDPOINT_H_
+#define OTMPSI_NETWORK_MUXENDPOINT_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "endpoint.h"
+#include "utils/buffer_pool.h"
+
+// Suffix of the names of the connections a MuxEndpoint opens on its inner endpoint
+const std::string muxConnectionSuffix = "#mux";
+
+// Flag of the stream ID of a frame that opens a stream, the payload is the name of the opening side
+const uint32 muxOpenFlag = 0x80000000u;
+
+// Flag of the stream ID of a frame that returns send credit, the length is the number of bytes granted
+const uint32 muxCreditFlag = 0x40000000u;
+
+// Stream ID of the frame that tells the remote reader no more frames follow on a connection
+const uint32 muxCloseStream = 0xffffffffu;
+
+// Number of bytes a stream may send ahead of its reader, the receive queue of a stream holds at most this
+// and one frame more
+const uint64 muxStreamWindow = 4 << 20;
+
+// Connection index of a peer connection that is still being opened, and of one that could not be opened
+const uint32 muxPendingConnection = 0xffffffffu;
+const uint32 muxFailedConnection = 0xfffffffeu;
+
+// Class for an endpoint that multiplexes its channels as logical streams over a few connections per
+// peer address of an inner endpoint. Every message is a frame of a stream ID and a length followed by
+// the payload. Streams are opened by the side that opened the connection, and a reader thread per
+// connection sorts the incoming frames into the receive queues of the streams. A writer waits for send
+// credit, which the reading side returns as its thread consumes the frames, so a slow stream neither
+// grows its queue without bound nor holds up the other streams of its connection. Like a TCP channel,
+// every stream must be written by one thread and read by one thread
+class MuxEndpoint : public Endpoint {
+public:
+    // Delete the default constructor
+    MuxEndpoint() = delete;
+
+    // Constructor that takes the inner endpoint and the number of connections per peer address
+    MuxEndpoint(std::unique_ptr<Endpoint> inner, uint32 connections_per_peer);
+
+    // Destructor that stops the endpoint unless that was done already
+    ~MuxEndpoint() override;
+
+    // Method to start the endpoint
+    void Start() override { inner_->Start(); };
+
+    // Method to stop the endpoint, waits until every peer has stopped its side of the connections
+    void Stop() override;
+
+    // Method to stop listen
+    void StopListen() override { inner_->StopListen(); };
+
+    // Method to open a stream to a remote endpoint, a new connection is opened only while the
+    // address has fewer than connections_per_peer
+    void
+    Connect(const std::string &remote_name, const std::string &remote_address, const std::string &local_name) override;
+
+    // Method to close a stream with a remote endpoint
+    void CloseChannel(const std::string &remote_name) override;
+
+    // Method to write data to a remote endpoint
+    void Write(const std::string &remote_name, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a remote endpoint as one frame
+    void Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to read data from a remote endpoint
+    void Read(const std::string &remote_name, void *buf, uint32 len) override;
+
+    // Method to resolve the stream of a connected remote endpoint into a handle
+    ChannelHandle GetChannel(const std::string &remote_name) override;
+
+    // Method to write data to a channel
+    void Write(ChannelHandle channel, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a channel as one frame
+    void Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to take a send buffer of len bytes for AsyncWrite on a channel
+    std::vector<uint8> AcquireBuffer(ChannelHandle channel, uint32 len) override;
+
+    // Method to asynchronously write a buffer to a channel as one frame
+    void AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) override;
+
+    // Method to wait until all asynchronous writes on the connection of a channel have completed
+    void Flush(ChannelHandle channel) override;
+
+    // Method to read data from a channel
+    void Read(ChannelHandle channel, void *buf, uint32 len) override;
+
+    // Method to get the names of all open streams, picking up connections accepted by the inner endpoint
+    std::vector<std::string> GetRemoteNames() override;
+
+    // Method to get the total amount of data sent, frame headers included
+    uint64 GetTotalBytesSent() const override { return inner_->GetTotalBytesSent(); };
+
+    // Method to get the total amount of data received, frame headers included
+    uint64 GetTotalBytesReceived() const override { return inner_->GetTotalBytesReceived(); };
+
+    // Method to reset the total amount of data sent and received
+    void ResetCounters() override { inner_->ResetCounters(); };
+
+private:
+    // Struct for the header of a frame
+    struct FrameHeader {
+        uint32 stream;
+        uint32 length;
+    };
+
+    // Struct for a logical stream and the frames received for it
+    struct Stream {
+        uint32 connection;
+        uint32 id;
+        std::mutex mtx; // guards frames, offset, consumed and credit
+        std::condition_variable cv; // signals new frames to the reading thread
+        std::deque<std::vector<uint8>> frames;
+        size_t offset = 0; // bytes of frames.front() already read
+        uint64 consumed = 0; // bytes read and not yet granted back to the remote
+        std::condition_variable credit_cv; // signals new send credit to the writing thread
+        long credit = muxStreamWindow; // bytes the remote accepts, negative after a frame above the window
+    };
+
+    // Struct for a connection of the inner endpoint
+    struct Connection {
+        ChannelHandle handle;
+        std::mutex write_mtx; // keeps the header and the payload of a frame together
+        uint32 next_stream = 0; // ID of the next stream opened on the connection
+        std::unordered_map<uint32, uint32> streams; // stream index by stream ID, guarded by mtx_
+        std::thread reader;
+    };
+
+    // Method to resolve a connection of the inner endpoint and start its reader, called with mtx_ held
+    uint32 AddConnection(const std::string &inner_name);
+
+    // Method to add a stream on a connection, called with mtx_ held
+    uint32 AddStream(uint32 connection, uint32 id, const std::string &remote_name);
+
+    // Method to find the stream of a remote endpoint by name
+    ChannelHandle FindStream(const std::string &remote_name);
+
+    // Method to wait for send credit on a stream and take len bytes of it
+    void TakeCredit(Stream &stream, uint64 len);
+
+    // Method to write a frame on a connection
+    void WriteFrame(uint32 connection, uint32 stream, const std::vector<ConstBuffer> &buffers);
+
+    // Main loop of the reader of a connection, returns on the close frame of the remote
+    void ReadFrames(uint32 connection);
+
+    std::unique_ptr<Endpoint> inner_;
+    uint32 connections_per_peer_;
+    BufferPool pool_; // receive buffers of the frames
+    bool stopped_ = false;
+
+    std::mutex mtx_; // guards the tables below against the readers
+    std::condition_variable connected_cv_; // signals a peer connection that was opened or failed
+    std::vector<std::unique_ptr<Connection>> connections_; // reserved up front, indexed by connection
+    std::vector<std::unique_ptr<Stream>> streams_; // reserved up front, indexed by ChannelHandle::index
+    std::unordered_map<std::string, uint32> stream_names_; // stream index by remote name
+    std::unordered_map<std::string, std::vector<uint32>> peer_connections_; // connection slots by peer address
+    std::unordered_map<std::string, uint32> peer_streams_; // number of streams opened by peer address
+    std::unordered_set<std::string> inner_names_; // names of the connections already added
+};
+
+#endif // OTMPSI_NETWORK_MUXENDPOINT_H_
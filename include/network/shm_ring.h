@@ -0,0 +1,67 @@
+#ifndef OTMPSI_NETWORK_SHMRING_H_
+#define OTMPSI_NETWORK_SHMRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "utils/common.h"
+
+const size_t defaultShmRingBytes = 1 << 20;
+
+// Struct for the control block at the start of a shared-memory ring, followed by the data. The peer can
+// write all of it, so a ring checks the header against its mapping once and keeps its own capacity
+struct ShmRingHeader {
+    uint64 capacity; // power of two, read only when the ring is opened
+    alignas(64) std::atomic<uint64> head; // bytes read, advanced by the consumer
+    std::atomic<uint32> head_seq; // futex word bumped whenever head moves
+    std::atomic<uint32> writer_waiting;
+    alignas(64) std::atomic<uint64> tail; // bytes written, advanced by the producer
+    std::atomic<uint32> tail_seq; // futex word bumped whenever tail moves
+    std::atomic<uint32> reader_waiting;
+};
+
+// Class for a single-producer single-consumer byte stream in a POSIX shared-memory object,
+// shared by two processes on the same host. A blocked side spins briefly and then sleeps on a
+// futex word in the header, the other side only makes the wake-up syscall if someone sleeps
+class ShmRing {
+public:
+    // Delete the default constructor
+    ShmRing() = delete;
+
+    // Unmaps the ring
+    ~ShmRing();
+
+    // Factory method to create a new ring of capacity bytes under a shared-memory name
+    static std::unique_ptr<ShmRing> Create(const std::string &name, size_t capacity);
+
+    // Factory method to map a ring created by another process, the name is unlinked once opened. Throws
+    // unless the capacity in the header is a power of two that fills the shared-memory object
+    static std::unique_ptr<ShmRing> Open(const std::string &name);
+
+    // Method to remove the name of a ring that will not be opened, a missing name is ignored
+    static void Unlink(const std::string &name);
+
+    // Method to append len bytes, blocks while the ring is full, throws on a corrupt head
+    void Write(const void *buf, size_t len);
+
+    // Method to take exactly len bytes, blocks until they are available, throws on a corrupt tail
+    void Read(void *buf, size_t len);
+
+private:
+    // Constructor that takes a mapping of map_bytes bytes holding a ring of capacity bytes
+    ShmRing(void *mapping, size_t map_bytes, uint64 capacity);
+
+    // Method to throw if the peer moved head or tail so that more than the capacity is in use
+    void CheckUsed(uint64 used) const;
+
+    void *mapping_;
+    size_t map_bytes_;
+    ShmRingHeader *header_;
+    uint8 *data_;
+    uint64 capacity_; // never reloaded from the header
+    uint64 mask_;
+};
+
+#endif // OTMPSI_NETWORK_SHMRING_H_
@@ -6,7 +6,9 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/thread.hpp>
+#include <condition_variable>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -15,63 +17,100 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
-
+#include <stdexcept>
 
 #include "endpoint.h"
+#include "network/shm_ring.h"
+#include "utils/buffer_pool.h"
 
 using boost::asio::ip::tcp;
 
 const int nameSizeLimit = 256;
 const int retryLimit = 20;
+const std::string shmScheme = "shm://";
+const std::string shmTransportTag = "shm";
 
 // Class for a TCP channel
 class TcpChannel : public boost::enable_shared_from_this<TcpChannel> {
 public:
     typedef boost::shared_ptr <TcpChannel> TcpChannelPointer;
 
-    // Constructor that takes a reference to an io_service object
-    explicit TcpChannel(boost::asio::io_service &io_service) : socket_(io_service) {};
+    // Constructor that takes a reference to an io_service object and the limit of bytes queued by AsyncWrite
+    TcpChannel(boost::asio::io_service &io_service, uint64 max_in_flight_bytes)
+            : socket_(io_service), max_in_flight_bytes_(max_in_flight_bytes) {};
 
     // Factory method to create a new TcpChannel object
-    static TcpChannelPointer Create(boost::asio::io_service &io_service) {
-        return TcpChannelPointer(new TcpChannel(io_service));
+    static TcpChannelPointer Create(boost::asio::io_service &io_service, uint64 max_in_flight_bytes) {
+        return TcpChannelPointer(new TcpChannel(io_service, max_in_flight_bytes));
     }
 
-    // Method to asynchronously write data to the channel
-    inline void AsyncWrite(void *buf, uint32 len);
+    // Method to take a send buffer of len bytes from the channel's pool
+    inline std::vector<uint8> AcquireBuffer(uint32 len);
+
+    // Method to asynchronously write a buffer to the channel, blocks while the bytes in flight exceed the limit
+    void AsyncWrite(std::vector<uint8> &&buf);
+
+    // Method to wait until all asynchronous writes have completed
+    void Flush();
+
+    // Method to move the data of the channel to shared-memory rings, the socket stays open
+    inline void AttachSharedMemory(std::unique_ptr<ShmRing> in, std::unique_ptr<ShmRing> out);
 
     // Method to write data to the channel
     inline void Write(const void *buf, uint32 len);
 
+    // Method to write several buffers to the channel with a single gathered write
+    inline void Write(const std::vector<ConstBuffer> &buffers);
+
     // Method to read data from the channel
     inline void Read(void *buf, uint32 len);
 
     // Method to get a reference to the underlying socket
     inline tcp::socket &socket();
 
+    // Method to check if the data of the channel goes through shared memory
+    [[nodiscard]] inline bool uses_shared_memory() const { return shm_out_ != nullptr; }
+
 private:
-    // Method to write data from the buffer to the socket
+    // Method to start writing the pending buffers, called with buffer_mtx_ held
     void DoWrite();
 
     // Handler for asynchronous write operations
     void WriteHandler(const boost::system::error_code &error, size_t size);
 
     tcp::socket socket_;
+    BufferPool pool_;
     std::mutex buffer_mtx_;
-    std::vector<std::pair<void *, int>> buffers_[2]; // a double buffer
+    std::condition_variable drained_;
+    std::vector<std::vector<uint8>> pending_; // queued by AsyncWrite, not yet handed to the socket
+    std::vector<std::vector<uint8>> writing_; // owned by the write in progress
     std::vector<boost::asio::const_buffer> buffer_seq_;
-    int active_buffer_ = 0;
+    bool write_in_progress_ = false;
+    uint64 in_flight_bytes_ = 0;
+    uint64 max_in_flight_bytes_;
+
+    // set for a peer on the same host that connected with an shm:// address
+    std::unique_ptr<ShmRing> shm_in_;
+    std::unique_ptr<ShmRing> shm_out_;
 };
 
-// Method to asynchronously write data to the channel
-void TcpChannel::AsyncWrite(void *buf, uint32 len) {
-    std::lock_guard<std::mutex> lock(buffer_mtx_);
-    buffers_[active_buffer_ ^ 1].emplace_back(buf, len); // move input data to the inactive buffer
-    DoWrite();
+// Method to take a send buffer of len bytes from the channel's pool
+std::vector<uint8> TcpChannel::AcquireBuffer(uint32 len) { return pool_.Acquire(len); }
+
+// Method to move the data of the channel to shared-memory rings, the socket stays open
+void TcpChannel::AttachSharedMemory(std::unique_ptr<ShmRing> in, std::unique_ptr<ShmRing> out) {
+    shm_in_ = std::move(in);
+    shm_out_ = std::move(out);
 }
 
 // Method to write data to the channel
 void TcpChannel::Write(const void *buf, uint32 len) {
+    if (shm_out_) {
+        shm_out_->Write(buf, len);
+        return;
+    }
+    // keep the byte stream ordered behind queued asynchronous writes
+    Flush();
     boost::system::error_code error;
     boost::asio::write(socket_, boost::asio::buffer(buf, len), error);
     if (error) {
@@ -79,8 +118,33 @@ void TcpChannel::Write(const void *buf, uint32 len) {
     }
 }
 
+// Method to write several buffers to the channel with a single gathered write
+void TcpChannel::Write(const std::vector<ConstBuffer> &buffers) {
+    if (shm_out_) {
+        for (const auto &b: buffers) {
+            shm_out_->Write(b.first, b.second);
+        }
+        return;
+    }
+    Flush();
+    std::vector<boost::asio::const_buffer> buffer_seq;
+    buffer_seq.reserve(buffers.size());
+    for (const auto &b: buffers) {
+        buffer_seq.emplace_back(b.first, b.second);
+    }
+    boost::system::error_code error;
+    boost::asio::write(socket_, buffer_seq, error);
+    if (error) {
+        std::cerr << "Error writing to socket: " << error.message() << std::endl;
+    }
+}
+
 // Method to read data from the channel
 void TcpChannel::Read(void *buf, uint32 len) {
+    if (shm_in_) {
+        shm_in_->Read(buf, len);
+        return;
+    }
     boost::system::error_code error;
     boost::asio::read(socket_, boost::asio::buffer(buf, len), error);
     if (error) {
@@ -100,14 +164,18 @@ public:
     // Default destructor
     ~TcpEndpoint() override = default;
 
-    // Constructor that takes a port number
-    explicit TcpEndpoint(int port) : acceptor_(io_service_, tcp::endpoint(tcp::v4(), port)), resolver_(io_service_) {};
+    // Constructor that takes a port number and the limit of asynchronously queued bytes per channel
+    explicit TcpEndpoint(int port, uint64 max_in_flight_bytes = defaultMaxInFlightBytes)
+            : max_in_flight_bytes_(max_in_flight_bytes), acceptor_(io_service_, tcp::endpoint(tcp::v4(), port)),
+              resolver_(io_service_) {
+        resolved_channels_.reserve(maxResolvedChannels);
+    };
 
     // Method to start the endpoint
     inline void Start() override;
 
     // Method to stop the endpoint
-    inline void Stop() override;
+    void Stop() override;
 
     // Method to stop listen
     inline void StopListen() override;
@@ -118,12 +186,33 @@ public:
     // Method to write data to a remote endpoint
     inline void Write(const std::string &remote_name, const void *buf, uint32 len) override;
 
-    // Method to asynchronously write data to a remote endpoint
-    inline void AsyncWrite(const std::string &remote_name, void *buf, uint32 len) override;
+    // Method to write several buffers to a remote endpoint with a single gathered write
+    inline void Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to take a send buffer of len bytes for AsyncWrite on a channel
+    inline std::vector<uint8> AcquireBuffer(ChannelHandle channel, uint32 len) override;
+
+    // Method to asynchronously write a buffer to a channel
+    inline void AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) override;
+
+    // Method to wait until all asynchronous writes on a channel have completed
+    inline void Flush(ChannelHandle channel) override;
 
     // Method to read data from a remote endpoint
     inline void Read(const std::string &remote_name, void *buf, uint32 len) override;
 
+    // Method to resolve the channel of a connected remote endpoint into a handle
+    ChannelHandle GetChannel(const std::string &remote_name) override;
+
+    // Method to write data to a channel
+    inline void Write(ChannelHandle channel, const void *buf, uint32 len) override;
+
+    // Method to write several buffers to a channel with a single gathered write
+    inline void Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) override;
+
+    // Method to read data from a channel
+    inline void Read(ChannelHandle channel, void *buf, uint32 len) override;
+
     // Method to get the names of all connected remote endpoints
     std::vector<std::string> GetRemoteNames() override;
 
@@ -140,6 +229,14 @@ public:
     // Method to reset the total amount of data sent and received
     void ResetCounters() override;
 
+protected:
+    std::vector<TcpChannel::TcpChannelPointer> resolved_channels_; // indexed by ChannelHandle::index
+    uint64 max_in_flight_bytes_;
+
+    //member variables to record the time and amount of data sent/received
+    uint64 total_bytes_sent_ = 0;
+    uint64 total_bytes_received_ = 0;
+
 private:
     // Handler for starting the endpoint
     inline void StartHandler();
@@ -151,22 +248,25 @@ private:
     inline void AcceptHandler(const TcpChannel::TcpChannelPointer &new_connection,
                               const boost::system::error_code &error);
 
+    // Method to attach the shared-memory rings named in the rest of a connection's name buffer, if any,
+    // and reply to the connecting side with one byte, 1 if they are attached and 0 to stay on TCP
+    void AcceptSharedMemory(const TcpChannel::TcpChannelPointer &new_connection, const char *rest, size_t len);
+
     std::unordered_map<std::string, TcpChannel::TcpChannelPointer> channels_;
     boost::asio::io_service io_service_;
     tcp::acceptor acceptor_;
     tcp::resolver resolver_;
+    std::unique_ptr<boost::asio::io_service::work> work_; // keeps io_service_ running for asynchronous writes
     bool accept_flag;
 
     boost::thread_group tg;
 
-    //member variables to record the time and amount of data sent/received
-    uint64 total_bytes_sent_ = 0;
-    uint64 total_bytes_received_ = 0;
     std::chrono::duration<double> total_network_time_ = std::chrono::duration<double>::zero();
 };
 
 // Method to start the endpoint
 void TcpEndpoint::Start() {
+    work_.reset(new boost::asio::io_service::work(io_service_));
     tg.create_thread(boost::bind(&TcpEndpoint::StartHandler, this));
 };
 
@@ -186,17 +286,57 @@ void TcpEndpoint::Write(const std::string &remote_name, const void *buf, uint32
     total_bytes_sent_ += len;
 };
 
-// Method to asynchronously write data to a remote endpoint
-void TcpEndpoint::AsyncWrite(const std::string &remote_name, void *buf, uint32 len) {
-    channels_[remote_name]->AsyncWrite(buf, len);
+// Method to write several buffers to a remote endpoint with a single gathered write
+void TcpEndpoint::Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) {
+    channels_[remote_name]->Write(buffers);
+    for (const auto &b: buffers) {
+        total_bytes_sent_ += b.second;
+    }
 };
 
+
 // Method to read data from a remote endpoint
 void TcpEndpoint::Read(const std::string &remote_name, void *buf, uint32 len) {
     channels_[remote_name]->Read(buf, len);
     total_bytes_received_ += len;
 };
 
+// Method to write data to a channel
+void TcpEndpoint::Write(ChannelHandle channel, const void *buf, uint32 len) {
+    resolved_channels_[channel.index]->Write(buf, len);
+    total_bytes_sent_ += len;
+}
+
+// Method to write several buffers to a channel with a single gathered write
+void TcpEndpoint::Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) {
+    resolved_channels_[channel.index]->Write(buffers);
+    for (const auto &b: buffers) {
+        total_bytes_sent_ += b.second;
+    }
+}
+
+// Method to take a send buffer of len bytes for AsyncWrite on a channel
+std::vector<uint8> TcpEndpoint::AcquireBuffer(ChannelHandle channel, uint32 len) {
+    return resolved_channels_[channel.index]->AcquireBuffer(len);
+}
+
+// Method to asynchronously write a buffer to a channel
+void TcpEndpoint::AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) {
+    total_bytes_sent_ += buf.size();
+    resolved_channels_[channel.index]->AsyncWrite(std::move(buf));
+}
+
+// Method to wait until all asynchronous writes on a channel have completed
+void TcpEndpoint::Flush(ChannelHandle channel) {
+    resolved_channels_[channel.index]->Flush();
+}
+
+// Method to read data from a channel
+void TcpEndpoint::Read(ChannelHandle channel, void *buf, uint32 len) {
+    resolved_channels_[channel.index]->Read(buf, len);
+    total_bytes_received_ += len;
+}
+
 // Handler for starting the endpoint
 void TcpEndpoint::StartHandler() {
     accept_flag = true;
@@ -206,7 +346,7 @@ void TcpEndpoint::StartHandler() {
 
 // Method to start accepting incoming connections
 void TcpEndpoint::StartAccept() {
-    TcpChannel::TcpChannelPointer new_connection = TcpChannel::Create(this->io_service_);
+    TcpChannel::TcpChannelPointer new_connection = TcpChannel::Create(this->io_service_, max_in_flight_bytes_);
     acceptor_.async_accept(new_connection->socket(), boost::bind(&TcpEndpoint::AcceptHandler, this, new_connection,
                                                                  boost::asio::placeholders::error));
 };
@@ -218,10 +358,14 @@ void TcpEndpoint::AcceptHandler(const TcpChannel::TcpChannelPointer &new_connect
         if (error) {
             std::cerr << "Error accepting connection: " << error.message() << std::endl;
         } else {
-            uint8 buffer[nameSizeLimit];
+            char buffer[nameSizeLimit];
             new_connection->Read(buffer, nameSizeLimit);
-            std::string remoteName(reinterpret_cast<char *>(buffer));
-            
+            buffer[nameSizeLimit - 1] = '\0';
+            std::string remoteName(buffer);
+
+            // a peer on the same host may ask to move the channel to shared memory
+            AcceptSharedMemory(new_connection, buffer + remoteName.size() + 1, nameSizeLimit - remoteName.size() - 1);
+
             channels_.insert(std::make_pair(remoteName, new_connection));
         }
         StartAccept();
@@ -2,25 +2,40 @@
 #define OTMPSI_PARTICIPANT_H
 
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+#include "crypto/ciphertext_array.h"
+#include "crypto/dlog_table.h"
 #include "crypto/threshold_elgamal.h"
-#include "network/tcp_endpoint.h"
+#include "network/endpoint_factory.h"
 #include "utils/bloom_filter.h"
+#include "utils/preprocessing_store.h"
 #include "utils/common.h"
+#include "utils/miss_counters.h"
+#include "utils/thread_pool.h"
 
 class Participant : KeyHolder {
 public:
-    // Constructor
-    Participant(const Options &options, const std::vector<ElementType> &set)
+    // Constructor that takes the network endpoint of the participant
+    Participant(const Options &options, const std::vector<ElementType> &set, std::unique_ptr<Endpoint> endpoint)
             : KeyHolder(options.p, options.alpha, options.phi_p_prime_factor_list),
-              endpoint_(new TcpEndpoint(options.port)),
+              endpoint_(std::move(endpoint)),
               elements_(set),
-              bf_(options.bloom_filter_size, options.murmurhash_seeds),
-              options_(options) {
+              bf_(options.bloom_filter_size, options.murmurhash_seeds, options.bloom_filter_block_size),
+              options_(options),
+              pool_(options.num_worker_threads > 0 ? options.num_worker_threads : options.concurrency_level,
+                    options.pin_worker_threads) {
         endpoint_->Start();
     };
 
+    // Constructor that listens on options.port with the endpoint selected by options.network_backend
+    Participant(const Options &options, const std::vector<ElementType> &set)
+            : Participant(options, set, NewEndpointFromOptions(options)) {};
+
     // Deleted default constructor
     Participant() = delete;
 
@@ -31,7 +46,10 @@ public:
     [[nodiscard]] Role role() const { return options_.role; };
 
     // Change the element set of the participant
-    void ChangeElementSet(const std::vector<ElementType> &new_set) { elements_ = new_set; };
+    void ChangeElementSet(const std::vector<ElementType> &new_set) {
+        elements_ = new_set;
+        element_positions_.clear();
+    };
 
     // Initialize the participant
     void Initialize();
@@ -45,15 +63,25 @@ public:
     // Execute the protocol
     std::vector<long long> Execute(bool print);
 
+    // Generate preprocessing bundles for later Execute calls into the store in options.preprocessing_dir.
+    // Uses the key persisted by an earlier Initialize and no network. Returns the number of fresh bundles
+    uint64 Preprocess(uint64 bundles);
+
     // Method to get the total amount of data sent in a more readable form
     inline uint64 GetTotalBytesSent() const;
 
     // Method to get the total amount of data received in a more readable form
     inline uint64 GetTotalBytesReceived() const;
 
+    // Method to get the worker pool of the compute loops, for its utilization counters
+    ThreadPool &pool() { return pool_; };
+
+    // Method to get the hardware cache and TLB misses of the workers in the membership tests so far (server only)
+    [[nodiscard]] inline const MissCounters::Counts &membership_test_misses() const { return membership_test_misses_; }
+
 private:
     // Network module
-    Endpoint *endpoint_;
+    std::unique_ptr<Endpoint> endpoint_;
 
     // Element set of the participant
     std::vector<ElementType> elements_;
@@ -61,31 +89,134 @@ private:
     // Bloom filter of the participant
     BloomFilter bf_;
 
+    // Bloom filter positions of the elements, bf_.num_hashes() per element. Computed by the first
+    // Execute and kept until the element set changes
+    std::vector<ContainerSizeType> element_positions_;
+
+    // Vote count lookup table over the powers vote_base^(q^l), rebuilt by PrepareServer (server only)
+    DlogTable dlog_table_;
+
+    // Preprocessed material for Execute, open when options.preprocessing_dir is set
+    std::unique_ptr<PreprocessingStore> store_;
+
     // Options for the protocol
     Options options_;
 
+    // Workers running the compute loops of every phase, independent of the number of channels
+    ThreadPool pool_;
+
+    // Set by Prepare in streaming mode when the encryptions of the ring pass are left to RingPass
+    bool stream_pending_ = false;
+
+    // Set by Execute when the Bloom filter positions do not fit in options.memory_budget_mb, the ring pass
+    // then runs window by window
+    bool windowed_ = false;
+
+    // Misses of the workers summed over the membership tests so far (server only)
+    MissCounters::Counts membership_test_misses_{};
+
+    // vote_base the server encrypts the bases with when Prepare leaves them to a streaming or windowed ring pass
+    NTL::ZZ stream_vote_base_;
+
+    // Struct for the chunks of a streaming ring pass that the workers have encrypted, indexed by channel and chunk
+    struct StreamedChunks {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<std::vector<uint8>> done;
+        std::vector<std::pair<ContainerSizeType, ContainerSizeType>> slices; // positions of every channel
+        std::vector<std::pair<uint32, size_t>> order; // (channel, chunk) pairs in the order they are needed
+    };
+
+    // Channel handles to the server and the ring neighbors, indexed by channel number
+    std::vector<ChannelHandle> server_channels_;
+    std::vector<ChannelHandle> left_channels_;
+    std::vector<ChannelHandle> right_channels_;
+
+    // Channel handles to all other parties in party list order, indexed by channel number (server only)
+    std::vector<std::vector<ChannelHandle>> party_channels_;
+
+    // Give the remote time to accept after the connect of channel i if it opened a socket
+    void PauseAfterConnect(uint32 i);
+
+    // Resolve the channel handles once all connections are established
+    void ResolveChannels();
+
     // Perform distributed key generation
     void DistributedKeyGeneration();
 
+    // With pinned workers, allocate the numbers of every ciphertext on the worker whose slice it is in,
+    // so they are first touched on its NUMA node
+    void FirstTouchCiphertexts(std::vector<Ciphertext> &array);
+
+    // With pinned workers, zero the slice of the arena of every worker on it, so its pages are first
+    // touched on the worker's NUMA node
+    void FirstTouchCiphertexts(CiphertextArray &array);
+
+    // Hash the element set into element_positions_ unless it is already there
+    void HashElements();
+
+    // Encrypt a fresh pool of rerand_pool_size encryptions of 1 and install it for EncryptOne
+    void PrepareRerandomizers();
+
+    // Get the path of a file of this party in the preprocessing directory
+    [[nodiscard]] std::string PreprocessingPath(const std::string &extension) const;
+
+    // Load the persisted secret key and the joint public key saved with it, returns false if there is none
+    bool LoadKey(NTL::ZZ &public_key);
+
+    // Persist the secret key and the joint public key
+    void SaveKey();
+
+    // Open the preprocessing store for the current key and parameters
+    void OpenPreprocessingStore();
+
+    // Get the size of one preprocessing bundle: the server stores vote_base and encryptions of vote_base
+    // and vote_base^q for every position, a client one rerandomizer per position
+    [[nodiscard]] uint64 PreprocessingBundleBytes() const;
+
+    // Generate one preprocessing bundle
+    void GeneratePreprocessingBundle(std::vector<uint8> &bundle);
+
+    // Take a fresh bundle from the preprocessing store in place of Prepare's encryptions, returns false if there is none
+    bool TakePreprocessingBundle(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
+                                 std::vector<NTL::ZZ> &precomputed_table);
+
+    // Draw a random vote_base of order q^(n-t+1)
+    void GenerateVoteBase(NTL::ZZ &vote_base);
+
+    // Compute the extraction tables of a vote_base: precomputed_table and dlog_table_
+    void BuildVoteTables(const NTL::ZZ &vote_base, std::vector<NTL::ZZ> &precomputed_table);
+
     // Prepare for the protocol
-    void Prepare(std::vector<Ciphertext> &encrypted_bases,
-                 std::vector<Ciphertext> &rerand_array, std::vector<NTL::ZZ> &precomputed_table);
+    void Prepare(CiphertextArray &encrypted_bases,
+                 CiphertextArray &rerand_array, std::vector<NTL::ZZ> &precomputed_table);
+
+    // Get the number of Bloom filter positions that fit in options.memory_budget_mb, all of them without a budget
+    [[nodiscard]] ContainerSizeType ExecutionWindow() const;
+
+    // Get the directory of the server's file of returned ciphertexts, options.spill_dir or the temp directory
+    [[nodiscard]] std::string SpillDir() const;
 
-    // Pass the bases on the ring, each participant applies its operation
-    void RingPass(std::vector<Ciphertext> &encrypted_bases,
-                  const std::vector<Ciphertext> &rerand_array);
+    // Encrypt the ring pass inputs of a window and pass it on the ring, one window after the other. The
+    // client's rerand_array holds one window, the server's file-backed bases are dropped from memory once back
+    void RingPassWindows(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
+                         ContainerSizeType window);
+
+    // Pass the bases in [begin, end) on the ring, each participant applies its operation
+    void RingPass(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
+                  ContainerSizeType begin, ContainerSizeType end);
 
 
     // Find the intersection of the sets
     void FindIntersection(std::vector<std::pair<int, uint64>> &intersection,
-                          const std::vector<Ciphertext> &encrypted_bases,
-                          const std::vector<Ciphertext> &rerand_array, const std::vector<NTL::ZZ> &precomputed_table);
+                          const CiphertextArray &encrypted_bases,
+                          const CiphertextArray &rerand_array, const std::vector<NTL::ZZ> &precomputed_table);
 
     // Send an NTL::ZZ to a remote participant
-    inline void SendZz(const std::string &remote, const NTL::ZZ &n, int channel);
+    inline void SendZz(ChannelHandle channel, const NTL::ZZ &n);
 
     // Receive an NTL::ZZ from a remote participant
-    inline void ReceiveZz(const std::string &remote, NTL::ZZ &n, int channel);
+    inline void ReceiveZz(ChannelHandle channel, NTL::ZZ &n);
 
     // Broadcast an NTL::ZZ to all remote participants
     void BroadcastZz(const NTL::ZZ &n, int channel);
@@ -93,11 +224,39 @@ private:
     // Collect NTL::ZZs from all remote participants
     void CollectZz(std::vector<NTL::ZZ> &zz_array, int channel);
 
+    // Send NTL::ZZs to a remote participant as one framed message
+    void SendZzArray(ChannelHandle channel, const std::vector<NTL::ZZ> &zz_array);
+
+    // Receive a framed message of at most max_count NTL::ZZs from a remote participant, throws on a larger count
+    void ReceiveZzArray(ChannelHandle channel, std::vector<NTL::ZZ> &zz_array, uint32 max_count);
+
+    // Broadcast NTL::ZZs to all remote participants, one framed message per participant
+    void BroadcastZzArray(const std::vector<NTL::ZZ> &zz_array, int channel);
+
+    // Collect one framed message of at most max_count NTL::ZZs from every remote participant
+    void CollectZzArray(std::vector<std::vector<NTL::ZZ>> &zz_arrays, int channel, uint32 max_count);
+
+    // Method to serialize NTL::ZZs into a framed message: a uint32 count followed by the numbers
+    void PackZzArray(std::vector<uint8> &buf, const std::vector<NTL::ZZ> &zz_array);
+
+    // Queue count ciphertexts of an array from start on for a remote participant as one framed message:
+    // a uint32 count, the c1 span and the c2 span. The message is sent asynchronously from a pooled buffer
+    void SendCiphertextChunk(ChannelHandle channel, const CiphertextArray &array, ContainerSizeType start, uint32 count);
+
+    // Receive a framed message of 1 to max_count ciphertexts from a remote participant straight into an array
+    // from start on, returns the count. Throws on any other count
+    uint32 ReceiveCiphertextChunk(ChannelHandle channel, CiphertextArray &array, ContainerSizeType start,
+                                  uint32 max_count);
+
+    // Receive a framed message of 1 to max_count ciphertexts from a remote participant into chunk, resized to
+    // the count. Throws on any other count
+    void ReceiveCiphertextChunk(ChannelHandle channel, CiphertextArray &chunk, uint32 max_count);
+
     // Send a ciphertext to a remote participant
-    inline void SendCiphertext(const std::string &remote, const Ciphertext &ciphertext, int channel);
+    inline void SendCiphertext(ChannelHandle channel, const Ciphertext &ciphertext);
 
     // Receive a ciphertext from a remote participant
-    inline void ReceiveCiphertext(const std::string &remote, Ciphertext &ciphertext, int channel);
+    inline void ReceiveCiphertext(ChannelHandle channel, Ciphertext &ciphertext);
 
     // Broadcast a ciphertext to all remote participants
     void BroadcastCiphertext(const Ciphertext &ciphertext, int channel);
@@ -117,27 +276,52 @@ private:
     // Perform distributed key generation for the client participant
     void DistributedKeyGenerationClient();
 
+    // Encrypt vote_base or vote_base^q into the bases in [start, end) by the inverted Bloom filter
+    void EncryptBases(CiphertextArray &encrypted_bases, const NTL::ZZ &vote_base,
+                      ContainerSizeType start, ContainerSizeType end);
+
+    // Encrypt 1 into the rerandomizers in [start, end)
+    void EncryptOnes(CiphertextArray &rerand_array, ContainerSizeType start, ContainerSizeType end);
+
+    // Lay out the ring pass chunks of every channel in chunks and mark them all pending. Call before the
+    // channel threads start, they wait on the layout
+    void LayoutStreamed(StreamedChunks &chunks);
+
+    // Run encrypt on the workers over the chunks laid out by LayoutStreamed, the first chunks of every
+    // channel first, and mark each chunk in chunks once it is done
+    void EncryptStreamed(StreamedChunks &chunks,
+                         const std::function<void(ContainerSizeType start, ContainerSizeType end)> &encrypt);
+
+    // Wait until the workers have encrypted a chunk of a channel
+    void WaitStreamed(StreamedChunks &chunks, int channel, size_t chunk);
+
     // Prepare for the protocol for the server participant
-    void PrepareServer(std::vector<Ciphertext> &encrypted_bases, std::vector<Ciphertext> &rerand_array,
+    void PrepareServer(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
                        std::vector<NTL::ZZ> &precomputed_table);
 
     // Prepare for the protocol for the client participant
-    void PrepareClient(std::vector<Ciphertext> &rerand_array);
+    void PrepareClient(CiphertextArray &rerand_array);
 
-    // Pass the bases on the ring for the server participant
-    void RingPassServer(std::vector<Ciphertext> &encrypted_bases);
+    // Pass the bases on the ring for the server participant, in chunks of ring_pass_chunk_size.
+    // In streaming mode every chunk is encrypted right before it is sent
+    void RingPassServer(CiphertextArray &encrypted_bases, ContainerSizeType begin, ContainerSizeType end);
 
-    // Pass the bases on the ring for the client participant
-    void RingPassClient(std::vector<Ciphertext> &encrypted_bases, const std::vector<Ciphertext> &rerand_array);
+    // Pass the bases on the ring for the client participant, working on one chunk while the next is received.
+    // In streaming mode the rerandomizers are encrypted alongside, in the order the chunks arrive.
+    // Ciphertext 0 of rerand_array is the rerandomizer of position begin
+    void RingPassClient(CiphertextArray &rerand_array, ContainerSizeType begin, ContainerSizeType end);
 
-    // Membership test for server participant
+    // Membership test for server participant. The elements are taken in tiles of
+    // options.membership_test_tile_size, and the bases of a tile are read in Bloom filter position order
     void MembershipTestServer(std::vector<Ciphertext> &encrypted_membership_test_results,
-                              const std::vector<Ciphertext> &encrypted_bases);
+                              const CiphertextArray &encrypted_bases);
 
-    // Perform mutual decryption for the server participant
-    void MutualDecryptServer(NTL::ZZ &result, const Ciphertext &c, int channel);
+    // Perform mutual decryption of the ciphertexts in [start, end) for the server participant.
+    // All c1 values go out in one message and every client answers with one message
+    void MutualDecryptServer(std::vector<NTL::ZZ> &results, const std::vector<Ciphertext> &c,
+                             ContainerSizeType start, ContainerSizeType end, int channel);
 
-    // Perform mutual decryption for the client participant
+    // Perform mutual decryption of one batch for the client participant
     void MutualDecryptClient(int channel);
 
     // Extract the hidden count for server participant
@@ -151,30 +335,26 @@ private:
 };
 
 
-void Participant::SendZz(const std::string &remote, const NTL::ZZ &n, int channel) {
-    // unsigned char buf[options_.num_bytes_field_numbers];
-    // BytesFromZZ(buf, n, options_.num_bytes_field_numbers);
-    // endpoint_->AsyncWrite(remote, buf, options_.num_bytes_field_numbers);
-
-    unsigned char buf[options_.num_bytes_field_numbers];
-    BytesFromZZ(buf, n, options_.num_bytes_field_numbers);
-    endpoint_->Write(remote + "_" + std::to_string(channel), buf, options_.num_bytes_field_numbers);
+void Participant::SendZz(ChannelHandle channel, const NTL::ZZ &n) {
+    std::vector<uint8> buf(options_.num_bytes_field_numbers);
+    BytesFromZZ(buf.data(), n, options_.num_bytes_field_numbers);
+    endpoint_->Write(channel, buf.data(), options_.num_bytes_field_numbers);
 }
 
-void Participant::ReceiveZz(const std::string &remote, NTL::ZZ &n, int channel) {
-    unsigned char buf[options_.num_bytes_field_numbers];
-    endpoint_->Read(remote + "_" + std::to_string(channel), buf, options_.num_bytes_field_numbers);
-    ZZFromBytes(n, buf, options_.num_bytes_field_numbers);
+void Participant::ReceiveZz(ChannelHandle channel, NTL::ZZ &n) {
+    std::vector<uint8> buf(options_.num_bytes_field_numbers);
+    endpoint_->Read(channel, buf.data(), options_.num_bytes_field_numbers);
+    ZZFromBytes(n, buf.data(), options_.num_bytes_field_numbers);
 }
 
-void Participant::SendCiphertext(const std::string &remote, const Ciphertext &ciphertext, int channel) {
-    SendZz(remote, ciphertext.first, channel);
-    SendZz(remote, ciphertext.second, channel);
+void Participant::SendCiphertext(ChannelHandle channel, const Ciphertext &ciphertext) {
+    SendZz(channel, ciphertext.first);
+    SendZz(channel, ciphertext.second);
 }
 
-void Participant::ReceiveCiphertext(const std::string &remote, Ciphertext &ciphertext, int channel) {
-    ReceiveZz(remote, ciphertext.first, channel);
-    ReceiveZz(remote, ciphertext.second, channel);
+void Participant::ReceiveCiphertext(ChannelHandle channel, Ciphertext &ciphertext) {
+    ReceiveZz(channel, ciphertext.first);
+    ReceiveZz(channel, ciphertext.second);
 }
 
 void Participant::Stop() { endpoint_->Stop(); }
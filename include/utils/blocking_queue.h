@@ -0,0 +1,48 @@
+#ifndef OTMPSI_UTILS_BLOCKINGQUEUE_H_
+#define OTMPSI_UTILS_BLOCKINGQUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <queue>
+
+// Class for a bounded blocking queue between a producer and a consumer thread
+template<typename T>
+class BlockingQueue {
+public:
+    // Delete the default constructor
+    BlockingQueue() = delete;
+
+    // Constructor that takes the maximum number of queued items
+    explicit BlockingQueue(size_t capacity) : capacity_(capacity) {};
+
+    // Default destructor
+    ~BlockingQueue() = default;
+
+    // Method to append an item, blocks while the queue is full
+    void Push(T item) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    // Method to take the oldest item, blocks while the queue is empty
+    T Pop() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_empty_.wait(lock, [this] { return !items_.empty(); });
+        T item = std::move(items_.front());
+        items_.pop();
+        not_full_.notify_one();
+        return item;
+    }
+
+private:
+    size_t capacity_;
+    std::queue<T> items_;
+    std::mutex mtx_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+#endif // OTMPSI_UTILS_BLOCKINGQUEUE_H_
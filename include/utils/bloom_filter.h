@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "common.h"
+#include "thread_pool.h"
 
 // Class for a Bloom filter
 class BloomFilter {
@@ -17,13 +18,18 @@ public:
     // Default destructor
     ~BloomFilter() = default;
 
-    // Constructor that takes the size of the filter and a vector of MurmurHash seeds
-    BloomFilter(const ContainerSizeType &size, const std::vector<uint32> &murmurhash_seeds)
-            : size_(size), bit_array_(boost::dynamic_bitset<>(size)), murmurhash_seeds_(murmurhash_seeds) {};
+    // Constructor that takes the size of the filter, a vector of MurmurHash seeds and the block size.
+    // A block size of 0 hashes every seed over the whole filter, otherwise the filter is blocked
+    // and the block size must be a power of two of at least as many positions as seeds, dividing the size
+    BloomFilter(const ContainerSizeType &size, const std::vector<uint32> &murmurhash_seeds,
+                ContainerSizeType block_size = 0);
 
     // Method to get the size of the filter
     [[nodiscard]] inline ContainerSizeType size() const;
 
+    // Method to get the number of positions per element
+    [[nodiscard]] inline ContainerSizeType num_hashes() const;
+
     // Method to invert the filter
     inline void Invert();
 
@@ -39,19 +45,37 @@ public:
     // Method to check if an element is in the filter
     bool CheckElement(const ElementType &e);
 
+    // Method to compute the positions of an element, one per MurmurHash seed
+    void HashPositions(const ElementType &e, std::vector<ContainerSizeType> &positions) const;
+
+    // Method to compute the positions of all elements into a row-major matrix with num_hashes() columns,
+    // splitting the elements over the workers of pool
+    void HashPositions(const std::vector<ElementType> &elements, std::vector<ContainerSizeType> &positions,
+                       ThreadPool &pool) const;
+
+    // Method to insert elements given by a position matrix from the batch HashPositions
+    void InsertPositions(const std::vector<ContainerSizeType> &positions);
+
 private:
     ContainerSizeType size_; // size of the bloom filter
     boost::dynamic_bitset<> bit_array_; // underlying bit array
     std::vector<uint32> murmurhash_seeds_; // murmurhash seeds for hash functions
+    ContainerSizeType block_size_; // 0 for an unblocked filter
 };
 
-// Method to get all the hashed positions using the murmurhash seeds
+// Method to get all the hashed positions using the murmurhash seeds. With a non-zero block size
+// the filter is blocked: a single MurmurHash with the first seed picks a block of block_size
+// positions, and Kirsch-Mitzenmacher double hashing g1 + i * g2 derives all positions inside it
 std::vector<ContainerSizeType>
-GetHashPositions(const ElementType &e, ContainerSizeType size, const std::vector<uint> &murmurhash_seeds);
+GetHashPositions(const ElementType &e, ContainerSizeType size, const std::vector<uint> &murmurhash_seeds,
+                 ContainerSizeType block_size = 0);
 
 // Method to get the size of the filter
 ContainerSizeType BloomFilter::size() const { return size_; }
 
+// Method to get the number of positions per element
+ContainerSizeType BloomFilter::num_hashes() const { return murmurhash_seeds_.size(); }
+
 // Method to check if a position in the filter is set
 bool BloomFilter::CheckPosition(const ContainerSizeType &pos) { return bit_array_[pos] == 1; }
 
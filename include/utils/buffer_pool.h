@@ -0,0 +1,49 @@
+#ifndef OTMPSI_UTILS_BUFFERPOOL_H_
+#define OTMPSI_UTILS_BUFFERPOOL_H_
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "utils/common.h"
+
+// Class for a thread-safe pool of byte buffers, released buffers keep their capacity so
+// steady-state sends do not allocate
+class BufferPool {
+public:
+    // Constructor that takes the maximum number of idle buffers kept in the pool
+    explicit BufferPool(size_t max_idle = 64) : max_idle_(max_idle) {};
+
+    // Default destructor
+    ~BufferPool() = default;
+
+    // Method to take a buffer of len bytes from the pool
+    std::vector<uint8> Acquire(size_t len) {
+        std::vector<uint8> buf;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!idle_.empty()) {
+                buf = std::move(idle_.back());
+                idle_.pop_back();
+            }
+        }
+        buf.resize(len);
+        return buf;
+    }
+
+    // Method to return a buffer to the pool
+    void Release(std::vector<uint8> &&buf) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (idle_.size() < max_idle_) {
+            idle_.push_back(std::move(buf));
+        }
+    }
+
+private:
+    size_t max_idle_;
+    std::vector<std::vector<uint8>> idle_;
+    std::mutex mtx_;
+};
+
+#endif // OTMPSI_UTILS_BUFFERPOOL_H_
@@ -26,6 +26,31 @@ const ContainerSizeType containerSizeTypeMax = UINT32_MAX;
 // Define the number of words in an element type
 const int elementTypeWords = 4;
 
+// Define the default number of ciphertexts per ring pass message
+const uint32 defaultRingPassChunkSize = 256;
+
+// Define the default limit of bytes queued for asynchronous sending per channel
+const uint64 defaultMaxInFlightBytes = 8 << 20;
+
+// Define the names of the network backends
+const std::string networkBackendTcp = "tcp";
+const std::string networkBackendIoUring = "io_uring";
+
+// Define the names of the instruction sets of the batched modular multiplications
+const std::string simdMulModAuto = "auto";
+const std::string simdMulModAvx512Ifma = "avx512ifma";
+const std::string simdMulModAvx2 = "avx2";
+const std::string simdMulModNone = "none";
+
+// Define the default window width of the fixed-base exponentiation tables
+const uint32 defaultFixedBaseWindowBits = 6;
+
+// Define the default number of elements whose membership tests read their bases in position order
+const uint32 defaultMembershipTestTileSize = 4096;
+
+// Define the default limit of products in the discrete-log table of the vote counts
+const uint64 defaultDlogTableMaxEntries = 1 << 20;
+
 // Enum for the role of a party in the protocol
 enum Role {
     client = 0,
@@ -42,17 +67,36 @@ struct Options {
 
 
     ContainerSizeType bloom_filter_size; // size of Bloom Filter.
+    ContainerSizeType bloom_filter_block_size; // positions per block of a blocked Bloom Filter, 0 if unblocked
     double false_positive_rate; 
 
     Role role; // client or server
     uint32 port; // server listening port
     uint32 id; // index
     std::string local_name; // local_name
-    uint32 concurrency_level; // number of threads
+    uint32 concurrency_level; // number of network channels per peer
     std::string server_address; // address of head
     std::string right_neighbor_address; // address of right neighbor on the ring
     std::vector<std::string> party_list; // all parties' name
     uint32 num_bytes_field_numbers; // number of bytes for numbers belongs to prime field p_
+    uint32 fixed_base_window_bits; // window width of the alpha/beta tables, 0 disables them
+    uint32 short_exponent_bits; // length of the encryption randomness, 0 draws it below p_
+    std::string simd_mul_mod; // instruction set of the batched multiplications: auto, avx512ifma, avx2 or none
+    uint32 ring_pass_chunk_size; // number of ciphertexts per ring pass message
+    uint64 max_in_flight_bytes; // limit of bytes queued for asynchronous sending per channel
+    std::string network_backend; // tcp or io_uring
+    bool zero_copy_send; // io_uring only, send large payloads with SEND_ZC
+    uint64 dlog_table_max_entries; // limit of products in the vote count lookup table, 0 disables it
+    uint32 rerand_pool_size; // number of pooled encryptions of 1 for rerandomization, 0 encrypts every one
+    uint32 rerand_subset_size; // number of pooled encryptions multiplied into each rerandomizer
+    std::string preprocessing_dir; // directory of the persisted key and preprocessing store, empty disables them
+    uint32 num_worker_threads; // number of compute threads, 0 uses concurrency_level
+    bool pin_worker_threads; // pin the compute threads to cores, NUMA node by node
+    bool stream_prepare; // encrypt the ring pass inputs chunk by chunk during the ring pass
+    uint32 connections_per_peer; // sockets the channels to a peer are multiplexed over, 0 opens one per channel
+    uint64 memory_budget_mb; // memory for the per-position ring pass arrays, 0 keeps them whole
+    std::string spill_dir; // directory of the server's file of returned ciphertexts, empty uses the temp directory
+    uint32 membership_test_tile_size; // elements whose bases the server reads in position order, 0 for input order
 
     NTL::ZZ p; // large prime p_, 1024 bits. p_-1 also needs to have large prime factor
     NTL::ZZ q; // small prime q.
@@ -0,0 +1,46 @@
+#ifndef OTMPSI_UTILS_FIRSTERROR_H_
+#define OTMPSI_UTILS_FIRSTERROR_H_
+
+#include <exception>
+#include <mutex>
+
+// Class for carrying the first exception of several threads to the thread that joins them. An exception
+// that leaves the function of a std::thread terminates the process, so the threads run their work
+// through Run and the joining thread calls Rethrow once all of them are joined
+class FirstError {
+public:
+    // Default constructor
+    FirstError() = default;
+
+    // Default destructor
+    ~FirstError() = default;
+
+    // Method to run f and keep its exception if it is the first one, returns false if f threw
+    template<typename F>
+    bool Run(F &&f) noexcept {
+        try {
+            f();
+            return true;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            return false;
+        }
+    }
+
+    // Method to rethrow the first exception kept, if any
+    void Rethrow() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    std::mutex mtx_;
+    std::exception_ptr error_;
+};
+
+#endif // OTMPSI_UTILS_FIRSTERROR_H_
@@ -0,0 +1,47 @@
+#ifndef OTMPSI_UTILS_MISSCOUNTERS_H_
+#define OTMPSI_UTILS_MISSCOUNTERS_H_
+
+#include "utils/common.h"
+
+// Class for counting the cache references, last-level cache misses and data TLB misses of the calling
+// thread in user space with perf_event_open, from construction on. Where the kernel refuses a counter,
+// e.g. off Linux, in containers or with a restrictive perf_event_paranoid, that counter stays 0
+class MissCounters {
+public:
+    // Struct for the counts of the hardware events
+    struct Counts {
+        uint64 cache_references; // last-level cache accesses
+        uint64 cache_misses; // last-level cache misses
+        uint64 dtlb_misses; // data TLB load misses
+
+        Counts &operator+=(const Counts &other) {
+            cache_references += other.cache_references;
+            cache_misses += other.cache_misses;
+            dtlb_misses += other.dtlb_misses;
+            return *this;
+        }
+    };
+
+    // Constructor that opens and starts the counters for the calling thread
+    MissCounters();
+
+    // Destructor that closes the counters
+    ~MissCounters();
+
+    // Delete the copy constructor and assignment, the counters belong to one thread
+    MissCounters(const MissCounters &) = delete;
+    MissCounters &operator=(const MissCounters &) = delete;
+
+    // Method to check if the kernel granted all counters
+    [[nodiscard]] bool available() const;
+
+    // Method to read the counts since construction
+    [[nodiscard]] Counts Read() const;
+
+private:
+    static constexpr int kEvents = 3;
+
+    int fds_[kEvents] = {-1, -1, -1};
+};
+
+#endif // OTMPSI_UTILS_MISSCOUNTERS_H_
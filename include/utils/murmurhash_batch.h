@@ -0,0 +1,20 @@
+#ifndef OTMPSI_UTILS_MURMURHASHBATCH_H_
+#define OTMPSI_UTILS_MURMURHASHBATCH_H_
+
+#include "common.h"
+
+// Batched MurmurHash3_x86_128 of 4-byte ElementType keys. Lane i of a call hashes one key with one
+// seed and writes the same two 64-bit words as MurmurHash3_x86_128(&key, 4, seed, out + 2 * i), so
+// parties with and without SIMD agree on every position. The kernel is picked once at run time:
+// AVX-512F hashes 16 lanes per step, AVX2 8 lanes, and other CPUs use a scalar loop
+
+// Function to hash count keys with the same seed, out receives 2 * count words
+void MurmurHashKeys(const ElementType *keys, size_t count, uint32 seed, uint64 *out);
+
+// Function to hash one key with count seeds, out receives 2 * count words
+void MurmurHashSeeds(ElementType key, const uint32 *seeds, size_t count, uint64 *out);
+
+// Function to get the name of the kernel selected for this CPU: "avx512", "avx2" or "scalar"
+const char *MurmurHashKernelName();
+
+#endif // OTMPSI_UTILS_MURMURHASHBATCH_H_
@@ -0,0 +1,62 @@
+#ifndef OTMPSI_UTILS_PREPROCESSINGSTORE_H_
+#define OTMPSI_UTILS_PREPROCESSINGSTORE_H_
+
+#include <memory>
+#include <string>
+
+#include "utils/common.h"
+
+const uint64 preprocessingStoreVersion = 1;
+
+// Struct for the header page of a preprocessing store file, followed by the bundles
+struct PreprocessingStoreHeader {
+    char magic[8]; // "OTMPSIPP"
+    uint64 version;
+    uint64 fingerprint; // identifies the key and parameters the bundles were made for
+    uint64 bundle_bytes;
+    uint64 generated; // bundles appended so far
+    uint64 consumed; // bundles handed out so far, bundles [consumed, generated) are fresh
+};
+
+// Class for a file of fixed-size preprocessing bundles shared by a generator process and the party
+// consuming them. The header page stays mapped, and each bundle is mapped while it is written or
+// read. Every bundle is handed out exactly once: the consumed counter advances under an exclusive
+// flock before the bundle is read. Once all bundles are consumed the next Append truncates the file
+class PreprocessingStore {
+public:
+    // Delete the default constructor
+    PreprocessingStore() = delete;
+
+    // Unmaps the header and closes the file
+    ~PreprocessingStore();
+
+    // Factory method to open or create the store at path for bundles of bundle_bytes bytes. A store made
+    // for another fingerprint or bundle size is stale and gets emptied
+    static std::unique_ptr<PreprocessingStore> Open(const std::string &path, uint64 fingerprint, uint64 bundle_bytes);
+
+    // Method to append one bundle of bundle_bytes bytes
+    void Append(const uint8 *bundle);
+
+    // Method to take the oldest fresh bundle into buf, returns false if there is none
+    bool Take(uint8 *buf);
+
+    // Method to get the number of fresh bundles
+    uint64 Available();
+
+private:
+    // Constructor that takes the open file and its mapped header
+    PreprocessingStore(int fd, std::string path, uint64 page_bytes, PreprocessingStoreHeader *header);
+
+    // Method to get the file offset of a bundle
+    [[nodiscard]] inline uint64 BundleOffset(uint64 index) const;
+
+    int fd_;
+    std::string path_;
+    uint64 page_bytes_; // size of the header page, bundles start at this offset
+    PreprocessingStoreHeader *header_;
+};
+
+// Method to get the file offset of a bundle
+uint64 PreprocessingStore::BundleOffset(uint64 index) const { return page_bytes_ + index * header_->bundle_bytes; }
+
+#endif // OTMPSI_UTILS_PREPROCESSINGSTORE_H_
@@ -0,0 +1,105 @@
+#ifndef OTMPSI_UTILS_SPSCBYTEQUEUE_H_
+#define OTMPSI_UTILS_SPSCBYTEQUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "utils/common.h"
+
+// Class for a lock-free single-producer single-consumer byte stream over a ring buffer.
+// Head and tail count all bytes ever read and written, so their difference is the fill level.
+// A blocked side spins briefly and then sleeps on the other side's counter.
+class SpscByteQueue {
+public:
+    // Delete the default constructor
+    SpscByteQueue() = delete;
+
+    // Constructor that takes the capacity in bytes, rounded up to a power of two
+    explicit SpscByteQueue(size_t capacity) : data_(std::bit_ceil(std::max<size_t>(capacity, 64))),
+                                              mask_(data_.size() - 1) {};
+
+    // Default destructor
+    ~SpscByteQueue() = default;
+
+    // Method to append len bytes, blocks while the queue is full
+    void Write(const void *buf, size_t len);
+
+    // Method to take exactly len bytes, blocks until they are available
+    void Read(void *buf, size_t len);
+
+private:
+    // Number of polls before a blocked side goes to sleep
+    static const int spinLimit = 256;
+
+    std::vector<uint8> data_;
+    size_t mask_;
+    alignas(64) std::atomic<uint64> head_{0}; // bytes read, advanced by the consumer
+    alignas(64) std::atomic<uint64> tail_{0}; // bytes written, advanced by the producer
+};
+
+// Method to append len bytes, blocks while the queue is full
+inline void SpscByteQueue::Write(const void *buf, size_t len) {
+    auto src = static_cast<const uint8 *>(buf);
+    uint64 tail = tail_.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (len > 0) {
+        uint64 head = head_.load(std::memory_order_acquire);
+        size_t space = data_.size() - (tail - head);
+        if (space == 0) {
+            if (++spins > spinLimit) {
+                head_.wait(head, std::memory_order_acquire);
+            }
+            continue;
+        }
+        spins = 0;
+
+        // Copy up to the end of the ring and wrap around for the rest
+        size_t n = std::min(space, len);
+        size_t offset = tail & mask_;
+        size_t first = std::min(n, data_.size() - offset);
+        std::memcpy(&data_[offset], src, first);
+        std::memcpy(data_.data(), src + first, n - first);
+
+        tail += n;
+        src += n;
+        len -= n;
+        tail_.store(tail, std::memory_order_release);
+        tail_.notify_one();
+    }
+}
+
+// Method to take exactly len bytes, blocks until they are available
+inline void SpscByteQueue::Read(void *buf, size_t len) {
+    auto dst = static_cast<uint8 *>(buf);
+    uint64 head = head_.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (len > 0) {
+        uint64 tail = tail_.load(std::memory_order_acquire);
+        size_t available = tail - head;
+        if (available == 0) {
+            if (++spins > spinLimit) {
+                tail_.wait(tail, std::memory_order_acquire);
+            }
+            continue;
+        }
+        spins = 0;
+
+        size_t n = std::min(available, len);
+        size_t offset = head & mask_;
+        size_t first = std::min(n, data_.size() - offset);
+        std::memcpy(dst, &data_[offset], first);
+        std::memcpy(dst + first, data_.data(), n - first);
+
+        head += n;
+        dst += n;
+        len -= n;
+        head_.store(head, std::memory_order_release);
+        head_.notify_one();
+    }
+}
+
+#endif // OTMPSI_UTILS_SPSCBYTEQUEUE_H_
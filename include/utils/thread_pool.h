@@ -0,0 +1,106 @@
+#ifndef OTMPSI_UTILS_THREADPOOL_H_
+#define OTMPSI_UTILS_THREADPOOL_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/common.h"
+
+// Class for a persistent pool of worker threads running parallel loops.
+// ParallelFor hands every worker an equal contiguous slice of the range, and a worker runs its slice
+// in chunks from the front. A worker that runs out of work steals the back half of the largest slice
+// left, so workers that finish early help the slow ones instead of idling. Pinned workers are spread
+// over the NUMA nodes in order, so the slices of neighboring workers share a node, and they steal from
+// workers of their own node first
+class ThreadPool {
+public:
+    // Loop body over the indices [start, end), worker is the index of the running worker below size()
+    typedef std::function<void(size_t start, size_t end, size_t worker)> RangeFunction;
+
+    // Struct for the counters of one worker since the last ResetStats
+    struct WorkerStats {
+        uint64 busy_ns; // time spent in loop bodies
+        uint64 chunks; // chunks run
+        uint64 steals; // slices stolen from other workers
+        uint32 node; // NUMA node the worker is pinned to, 0 if unpinned
+    };
+
+    // Delete the default constructor
+    ThreadPool() = delete;
+
+    // Constructor that starts num_threads workers, at least one, and pins them to cores if pin is set
+    explicit ThreadPool(size_t num_threads, bool pin = false);
+
+    // Destructor that stops and joins the workers
+    ~ThreadPool();
+
+    // Method to get the number of workers
+    [[nodiscard]] inline size_t size() const { return workers_.size(); }
+
+    // Method to check if the workers are pinned to cores
+    [[nodiscard]] inline bool pinned() const { return pinned_; }
+
+    // Method to get the number of NUMA nodes the workers are spread over, 1 if unpinned
+    [[nodiscard]] inline size_t num_nodes() const { return num_nodes_; }
+
+    // Method to run body over [begin, end) on the workers and wait for it. A chunk size of 0 picks one
+    // that gives every worker several chunks. The first exception thrown by body is rethrown
+    void ParallelFor(size_t begin, size_t end, const RangeFunction &body, size_t chunk = 0);
+
+    // Method to get the counters of every worker
+    [[nodiscard]] std::vector<WorkerStats> Stats() const;
+
+    // Method to get the time since the last ResetStats
+    [[nodiscard]] uint64 ElapsedNanoseconds() const;
+
+    // Method to reset the counters of every worker
+    void ResetStats();
+
+private:
+    // Struct for the slice and counters of one worker
+    struct alignas(64) Worker {
+        std::mutex mtx; // guards next and end
+        size_t next = 0;
+        size_t end = 0;
+        std::atomic<uint64> busy_ns{0};
+        std::atomic<uint64> chunks{0};
+        std::atomic<uint64> steals{0};
+        uint32 node = 0;
+    };
+
+    // Method to pin every worker to a core, filling the NUMA nodes in order
+    void PinWorkers();
+
+    // Main loop of a worker thread
+    void Run(size_t worker);
+
+    // Method to take the next chunk for a worker from its own slice or by stealing, returns false when all work is taken
+    bool NextChunk(size_t worker, size_t &start, size_t &end);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex call_mtx_; // serializes ParallelFor calls
+    std::mutex mtx_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64 generation_ = 0; // bumped for every loop
+    size_t running_ = 0; // workers still busy with the current loop
+    bool stopping_ = false;
+    const RangeFunction *body_ = nullptr;
+    size_t chunk_ = 1;
+    std::exception_ptr error_;
+
+    std::chrono::steady_clock::time_point stats_start_;
+    bool pinned_ = false;
+    size_t num_nodes_ = 1;
+};
+
+#endif // OTMPSI_UTILS_THREADPOOL_H_
@@ -0,0 +1,167 @@
+#include "crypto/chacha_stream.h"
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The keystream words are copied out as bytes, which is the little-endian ChaCha20 output only on such hosts
+static_assert(std::endian::native == std::endian::little, "ChaChaStream requires a little-endian host");
+
+// Number of double rounds of ChaCha20
+const int chachaDoubleRounds = 10;
+
+// Size of a ChaCha20 block in bytes
+const size_t chachaBlockBytes = 64;
+
+// Function to run the ChaCha quarter round on four words of the state
+static inline void QuarterRound(uint32 &a, uint32 &b, uint32 &c, uint32 &d) {
+    a += b;
+    d = std::rotl(d ^ a, 16);
+    c += d;
+    b = std::rotl(b ^ c, 12);
+    a += b;
+    d = std::rotl(d ^ a, 8);
+    c += d;
+    b = std::rotl(b ^ c, 7);
+}
+
+// Function to fill dest with len bytes from the entropy source of the operating system
+static void OsEntropy(uint8 *dest, size_t len) {
+#ifdef __linux__
+    while (len > 0) {
+        ssize_t n = getrandom(dest, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS) {
+                break;
+            }
+            throw std::runtime_error(std::string("getrandom failed: ") + std::strerror(errno));
+        }
+        dest += n;
+        len -= n;
+    }
+#endif
+    // Kernels without getrandom, and other systems, go through the standard library's entropy source
+    std::random_device entropy;
+    for (size_t i = 0; i < len; i += sizeof(uint32)) {
+        uint32 word = entropy();
+        std::memcpy(dest + i, &word, std::min(sizeof(word), len - i));
+    }
+}
+
+// Constructor that keys the stream from the operating system
+ChaChaStream::ChaChaStream() {
+    Rekey();
+}
+
+// Method to get the stream of the calling thread, keyed on first use
+ChaChaStream &ChaChaStream::ThreadLocal() {
+    thread_local ChaChaStream stream;
+    return stream;
+}
+
+// Method to fill dest with len random bytes
+void ChaChaStream::Fill(uint8 *dest, size_t len) {
+    // A forked child must not repeat the bytes its parent draws
+    if (pid_ != getpid()) {
+        Rekey();
+    }
+    while (len > 0) {
+        if (position_ == kBufferBytes) {
+            Refill();
+        }
+        size_t n = std::min(len, kBufferBytes - position_);
+        std::memcpy(dest, buffer_ + position_, n);
+        position_ += n;
+        dest += n;
+        len -= n;
+    }
+}
+
+// Method to draw a uniform number in [0, 2^bits)
+void ChaChaStream::RandomBits(NTL::ZZ &dest, long bits) {
+    if (bits <= 0) {
+        dest = 0;
+        return;
+    }
+    long len = (bits + 7) / 8;
+    std::vector<uint8> bytes(len);
+    Fill(bytes.data(), len);
+    bytes[len - 1] &= 0xff >> (8 * len - bits);
+    NTL::ZZFromBytes(dest, bytes.data(), len);
+}
+
+// Method to draw a uniform number in [0, bound) by rejection, fewer than two draws on average
+void ChaChaStream::RandomBnd(NTL::ZZ &dest, const NTL::ZZ &bound) {
+    long bits = NTL::NumBits(bound);
+    do {
+        RandomBits(dest, bits);
+    } while (dest >= bound);
+}
+
+// Method to draw a uniform number in [0, bound) by rejection
+long ChaChaStream::RandomBnd(long bound) {
+    const uint64 range = static_cast<uint64>(bound);
+    const uint64 limit = UINT64_MAX - UINT64_MAX % range;
+    uint64 x;
+    do {
+        Fill(reinterpret_cast<uint8 *>(&x), sizeof(x));
+    } while (x >= limit);
+    return static_cast<long>(x % range);
+}
+
+// Method to draw a new key from the operating system and restart the keystream
+void ChaChaStream::Rekey() {
+    // "expand 32-byte k", then the key, a 64-bit block counter and a random 64-bit nonce
+    state_[0] = 0x61707865;
+    state_[1] = 0x3320646e;
+    state_[2] = 0x79622d32;
+    state_[3] = 0x6b206574;
+    OsEntropy(reinterpret_cast<uint8 *>(state_ + 4), 8 * sizeof(uint32));
+    state_[12] = 0;
+    state_[13] = 0;
+    OsEntropy(reinterpret_cast<uint8 *>(state_ + 14), 2 * sizeof(uint32));
+    position_ = kBufferBytes;
+    pid_ = getpid();
+}
+
+// Method to generate the next kBufferBytes bytes of keystream into the buffer
+void ChaChaStream::Refill() {
+    for (size_t block = 0; block < kBufferBytes / chachaBlockBytes; block++) {
+        uint32 x[16];
+        std::memcpy(x, state_, sizeof(x));
+        for (int i = 0; i < chachaDoubleRounds; i++) {
+            QuarterRound(x[0], x[4], x[8], x[12]);
+            QuarterRound(x[1], x[5], x[9], x[13]);
+            QuarterRound(x[2], x[6], x[10], x[14]);
+            QuarterRound(x[3], x[7], x[11], x[15]);
+            QuarterRound(x[0], x[5], x[10], x[15]);
+            QuarterRound(x[1], x[6], x[11], x[12]);
+            QuarterRound(x[2], x[7], x[8], x[13]);
+            QuarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {
+            x[i] += state_[i];
+        }
+        std::memcpy(buffer_ + block * chachaBlockBytes, x, chachaBlockBytes);
+
+        // The 64-bit block counter spans words 12 and 13
+        if (++state_[12] == 0) {
+            state_[13]++;
+        }
+    }
+    position_ = 0;
+}
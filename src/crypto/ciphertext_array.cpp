@@ -0,0 +1,129 @@
+#include "crypto/ciphertext_array.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+// Alignment of every arena, one cache line
+const size_t arenaAlignment = 64;
+
+// Size of a transparent huge page, arenas of at least this size are aligned to it
+const size_t hugePageBytes = 2 << 20;
+
+// Function to throw the current errno as an exception
+static void ThrowErrno(const std::string &what, const std::string &path) {
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+// Function to drop the whole pages within [begin, end) of a shared mapping from memory
+static void ReleasePages(uint8 *begin, uint8 *end) {
+    static const uintptr_t page_bytes = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page_bytes - 1) / page_bytes * page_bytes;
+    uintptr_t last = reinterpret_cast<uintptr_t>(end) / page_bytes * page_bytes;
+    if (first < last) {
+        // Dirty pages of a shared mapping stay in the page cache and are written back from there
+        madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+    }
+}
+
+// Releases the arena, unmaps it if it is a mapping of mapped_bytes
+void CiphertextArray::FreeArena::operator()(uint64 *p) const {
+    if (mapped_bytes > 0) {
+        munmap(p, mapped_bytes);
+    } else {
+        std::free(p);
+    }
+}
+
+// Method to reallocate the arena for size ciphertexts, number_bytes is rounded up to whole limbs
+void CiphertextArray::Resize(size_t size, uint32 number_bytes) {
+    arena_.reset();
+    size_ = size;
+    limbs_ = (number_bytes + sizeof(uint64) - 1) / sizeof(uint64);
+    if (bytes() == 0) {
+        return;
+    }
+
+    // The arena is not touched here, so the threads that first write it decide where its pages go
+    size_t alignment = bytes() >= hugePageBytes ? hugePageBytes : arenaAlignment;
+    size_t allocation = (bytes() + alignment - 1) / alignment * alignment;
+    auto arena = static_cast<uint64 *>(std::aligned_alloc(alignment, allocation));
+    if (arena == nullptr) {
+        throw std::bad_alloc();
+    }
+#ifdef __linux__
+    if (alignment == hugePageBytes) {
+        madvise(arena, allocation, MADV_HUGEPAGE);
+    }
+#endif
+    arena_ = std::unique_ptr<uint64[], FreeArena>(arena, FreeArena{});
+}
+
+// Function to create a new file in directory dir that no other process can open or replace, returns its fd
+static int CreateAnonymousFile(const std::string &dir) {
+#ifdef O_TMPFILE
+    // The file never has a name, so there is nothing to guess or to link to
+    int fd = open(dir.c_str(), O_RDWR | O_TMPFILE | O_EXCL, 0600);
+    if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)) {
+        return fd;
+    }
+#endif
+    // File systems without O_TMPFILE get a new file with a random name, which is removed right away
+    std::string path = dir + "/otmpsi_spill_XXXXXX";
+    int fd_named = mkstemp(path.data());
+    if (fd_named >= 0) {
+        unlink(path.c_str());
+    }
+    return fd_named;
+}
+
+// Method to reallocate the arena as a shared mapping of a new anonymous file in directory dir
+void CiphertextArray::Map(const std::string &dir, size_t size, uint32 number_bytes) {
+    arena_.reset();
+    size_ = size;
+    limbs_ = (number_bytes + sizeof(uint64) - 1) / sizeof(uint64);
+    if (bytes() == 0) {
+        return;
+    }
+
+    int fd = CreateAnonymousFile(dir);
+    if (fd < 0) {
+        ThrowErrno("Cannot create ciphertext file in", dir);
+    }
+    if (ftruncate(fd, bytes()) != 0) {
+        close(fd);
+        ThrowErrno("Cannot size ciphertext file in", dir);
+    }
+    void *mapping = mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int map_errno = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errno = map_errno;
+        ThrowErrno("Cannot map ciphertext file in", dir);
+    }
+    arena_ = std::unique_ptr<uint64[], FreeArena>(static_cast<uint64 *>(mapping), FreeArena{bytes()});
+}
+
+// Method to drop the pages of ciphertexts [start, end) of a file-backed array from memory
+void CiphertextArray::Release(size_t start, size_t end) {
+    if (!mapped() || start >= end) {
+        return;
+    }
+    ReleasePages(c1(start), c1(end));
+    ReleasePages(c2(start), c2(end));
+}
+
+// Method to store ciphertext i from little-endian values of len bytes, len at most number_bytes()
+void CiphertextArray::SetBytes(size_t i, const uint8 *c1_bytes, const uint8 *c2_bytes, uint32 len) {
+    std::memcpy(c1(i), c1_bytes, len);
+    std::memset(c1(i) + len, 0, number_bytes() - len);
+    std::memcpy(c2(i), c2_bytes, len);
+    std::memset(c2(i) + len, 0, number_bytes() - len);
+}
@@ -0,0 +1,74 @@
+#include "crypto/dlog_table.h"
+
+const uint8 ambiguousFactors = 0xff; // Entry::factors of a fingerprint shared by different products
+
+// Method to build the table for products of up to max_factors bases
+bool DlogTable::Build(const std::vector<NTL::ZZ> &bases, uint32 max_factors, const NTL::ZZ &p, uint64 max_entries) {
+    Clear();
+    if (bases.empty() || bases.size() > 0xff || max_factors >= ambiguousFactors ||
+        CountProducts(bases.size(), max_factors, max_entries) > max_entries) {
+        return false;
+    }
+
+    table_.reserve(CountProducts(bases.size(), max_factors, max_entries));
+    Enumerate(bases, max_factors, p, NTL::ZZ(1), Entry{0, 0}, 0);
+    return true;
+}
+
+// Method to add the products whose remaining factors have indices of at least first_index
+void DlogTable::Enumerate(const std::vector<NTL::ZZ> &bases, uint32 max_factors, const NTL::ZZ &p,
+                          const NTL::ZZ &product, Entry entry, uint32 first_index) {
+    auto inserted = table_.emplace(Fingerprint(product), entry);
+    if (!inserted.second) {
+        inserted.first->second.factors = ambiguousFactors;
+    }
+    if (entry.factors == max_factors) {
+        return;
+    }
+
+    // Factors are added in non-decreasing index order, so every multiset of bases is visited once
+    NTL::ZZ next;
+    for (uint32 i = first_index; i < bases.size(); i++) {
+        NTL::MulMod(next, product, bases[i], p);
+        Enumerate(bases, max_factors, p, next, Entry{static_cast<uint8>(entry.factors + 1), static_cast<uint8>(i)}, i);
+    }
+}
+
+// Method to drop the table
+void DlogTable::Clear() {
+    table_.clear();
+}
+
+// Method to look up a product
+bool DlogTable::Lookup(const NTL::ZZ &x, Entry &entry) const {
+    auto it = table_.find(Fingerprint(x));
+    if (it == table_.end() || it->second.factors == ambiguousFactors) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+// Method to count the products of up to max_factors of num_bases bases: the multisets of size at most
+// max_factors, C(num_bases + max_factors, max_factors)
+uint64 DlogTable::CountProducts(uint32 num_bases, uint32 max_factors, uint64 limit) {
+    uint64 count = 1;
+    for (uint64 i = 1; i <= max_factors; i++) {
+        count = count * (num_bases + i) / i;
+        if (count > limit) {
+            return limit + 1;
+        }
+    }
+    return count;
+}
+
+// Method to get the fingerprint of a number: its lowest 64 bits
+uint64 DlogTable::Fingerprint(const NTL::ZZ &x) {
+    uint8 bytes[sizeof(uint64)];
+    NTL::BytesFromZZ(bytes, x, sizeof(bytes));
+    uint64 fingerprint = 0;
+    for (int i = sizeof(bytes) - 1; i >= 0; i--) {
+        fingerprint = (fingerprint << 8) | bytes[i];
+    }
+    return fingerprint;
+}
@@ -0,0 +1,97 @@
+#include "crypto/fixed_base_exp.h"
+
+#include "crypto/montgomery_backend.h"
+#include "crypto/ntl_backend.h"
+
+// Method to build the tables for exponents of up to max_exponent_bits bits
+template<typename Backend>
+void FixedBaseExp<Backend>::Precompute(const Backend &backend, const Number &base, long max_exponent_bits,
+                                       long window_bits) {
+    Clear();
+    if (window_bits <= 0 || max_exponent_bits <= 0) {
+        return;
+    }
+
+    base_ = base;
+    window_bits_ = window_bits;
+    max_exponent_bits_ = max_exponent_bits;
+    num_windows_ = (max_exponent_bits + window_bits - 1) / window_bits;
+
+    long digits = (1L << window_bits) - 1;
+    table_.resize(num_windows_ * digits);
+
+    // window_base = base^(2^(w*i)) mod p
+    Number window_base = base;
+    for (long i = 0; i < num_windows_; i++) {
+        Number *row = &table_[i * digits];
+        row[0] = window_base;
+        for (long d = 1; d < digits; d++) {
+            backend.MulMod(row[d], row[d - 1], window_base);
+        }
+        // Advance to the next window: base^(2^(w*(i+1))) = row[2^w - 2] * window_base
+        backend.MulMod(window_base, row[digits - 1], window_base);
+    }
+}
+
+// Method to drop the tables
+template<typename Backend>
+void FixedBaseExp<Backend>::Clear() {
+    table_.clear();
+    table_.shrink_to_fit();
+    window_bits_ = 0;
+    max_exponent_bits_ = 0;
+    num_windows_ = 0;
+}
+
+// Method to compute dest = base^exponent mod p
+template<typename Backend>
+void FixedBaseExp<Backend>::PowerMod(const Backend &backend, Number &dest, const NTL::ZZ &exponent) const {
+    // Fall back to the generic exponentiation for exponents the tables do not cover
+    if (!ready() || exponent < 0 || NTL::NumBits(exponent) > max_exponent_bits_) {
+        backend.PowerMod(dest, base_, exponent);
+        return;
+    }
+
+    long digits = (1L << window_bits_) - 1;
+    bool first = true;
+    for (long i = 0; i < num_windows_; i++) {
+        // Collect the w-bit digit of the exponent in window i
+        long d = 0;
+        for (long b = window_bits_ - 1; b >= 0; b--) {
+            d = (d << 1) | NTL::bit(exponent, i * window_bits_ + b);
+        }
+        if (d == 0) {
+            continue;
+        }
+
+        const Number &entry = table_[i * digits + d - 1];
+        if (first) {
+            dest = entry;
+            first = false;
+        } else {
+            backend.MulMod(dest, dest, entry);
+        }
+    }
+
+    if (first) {
+        backend.One(dest);
+    }
+}
+
+// Method to get the memory used by the tables
+template<typename Backend>
+uint64 FixedBaseExp<Backend>::TableBytes(const Backend &backend) const {
+    return table_.size() * backend.NumberBytes();
+}
+
+template
+class FixedBaseExp<NtlBackend>;
+
+template
+class FixedBaseExp<MontgomeryBackend<20>>;
+
+template
+class FixedBaseExp<MontgomeryBackend<36>>;
+
+template
+class FixedBaseExp<MontgomeryBackend<52>>;
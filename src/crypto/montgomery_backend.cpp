@@ -0,0 +1,244 @@
+#include "crypto/montgomery_backend.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+// The limb arrays are filled with BytesFromZZ/ZZFromBytes, which use little-endian byte order
+static_assert(std::endian::native == std::endian::little, "MontgomeryBackend requires a little-endian host");
+
+// Function to write a non-negative NTL::ZZ below 2^(64 * n) into n limbs
+static void LimbsFromZz(mp_limb_t *limbs, const NTL::ZZ &z, int n) {
+    NTL::BytesFromZZ(reinterpret_cast<unsigned char *>(limbs), z, n * sizeof(mp_limb_t));
+}
+
+// Constructor that takes the modulus p, p must be odd and fit into Limbs limbs
+template<int Limbs>
+MontgomeryBackend<Limbs>::MontgomeryBackend(const NTL::ZZ &p) : modulus_(p) {
+    LimbsFromZz(p_, p, Limbs);
+
+    // Newton iteration for p^-1 mod 2^64, every step doubles the number of correct bits
+    mp_limb_t inv = p_[0];
+    for (int i = 0; i < 6; i++) {
+        inv *= 2 - p_[0] * inv;
+    }
+    p_inv_ = -inv;
+
+    NTL::ZZ r = (NTL::ZZ(1) << (Limbs * GMP_NUMB_BITS)) % p;
+    LimbsFromZz(one_.limbs, r, Limbs);
+    LimbsFromZz(r2_.limbs, NTL::MulMod(r, r, p), Limbs);
+}
+
+// Method to reduce a 2 * Limbs product t into dest = t / R mod p, t is clobbered
+template<int Limbs>
+void MontgomeryBackend<Limbs>::Redc(Number &dest, mp_limb_t *t) const {
+    mp_limb_t high = 0;
+    for (int i = 0; i < Limbs; i++) {
+        // Clear limb i by adding a multiple of p, and carry into limb i + Limbs
+        mp_limb_t u = t[i] * p_inv_;
+        mp_limb_t c = mpn_addmul_1(t + i, p_, Limbs, u);
+        mp_limb_t s = t[i + Limbs] + c;
+        mp_limb_t carry = s < c;
+        s += high;
+        carry += s < high;
+        t[i + Limbs] = s;
+        high = carry;
+    }
+
+    // The result is below 2p, subtract p once if needed
+    if (high || mpn_cmp(t + Limbs, p_, Limbs) >= 0) {
+        mpn_sub_n(dest.limbs, t + Limbs, p_, Limbs);
+    } else {
+        std::memcpy(dest.limbs, t + Limbs, sizeof(dest.limbs));
+    }
+}
+
+// Method to convert an NTL::ZZ into a field element
+template<int Limbs>
+void MontgomeryBackend<Limbs>::FromZz(Number &dest, const NTL::ZZ &src) const {
+    Number plain;
+    if (src < 0 || src >= modulus_) {
+        LimbsFromZz(plain.limbs, src % modulus_, Limbs);
+    } else {
+        LimbsFromZz(plain.limbs, src, Limbs);
+    }
+    // x * R^2 / R = x * R
+    MulMod(dest, plain, r2_);
+}
+
+// Method to convert a field element into an NTL::ZZ
+template<int Limbs>
+void MontgomeryBackend<Limbs>::ToZz(NTL::ZZ &dest, const Number &src) const {
+    // x * R / R = x
+    mp_limb_t t[2 * Limbs] = {0};
+    std::memcpy(t, src.limbs, sizeof(src.limbs));
+    Number plain;
+    Redc(plain, t);
+    NTL::ZZFromBytes(dest, reinterpret_cast<const unsigned char *>(plain.limbs), sizeof(plain.limbs));
+}
+
+// Method to compute dest = a * b mod p
+template<int Limbs>
+void MontgomeryBackend<Limbs>::MulMod(Number &dest, const Number &a, const Number &b) const {
+    mp_limb_t t[2 * Limbs];
+    mpn_mul_n(t, a.limbs, b.limbs, Limbs);
+    Redc(dest, t);
+}
+
+// Method to compute dest = a^2 mod p
+template<int Limbs>
+void MontgomeryBackend<Limbs>::SqrMod(Number &dest, const Number &a) const {
+    mp_limb_t t[2 * Limbs];
+    mpn_sqr(t, a.limbs, Limbs);
+    Redc(dest, t);
+}
+
+// Method to compute dest = base^exponent mod p, throws on a negative exponent
+template<int Limbs>
+void MontgomeryBackend<Limbs>::PowerMod(Number &dest, const Number &base, const NTL::ZZ &exponent) const {
+    // The windows below read the bits of |exponent|, so a negative one would silently give base^|exponent|
+    if (NTL::sign(exponent) < 0) {
+        throw std::invalid_argument("MontgomeryBackend::PowerMod needs a non-negative exponent");
+    }
+    long bits = NTL::NumBits(exponent);
+    if (bits == 0) {
+        One(dest);
+        return;
+    }
+
+    // Left-to-right sliding-window exponentiation over the odd powers of base, small exponents
+    // such as q use plain square-and-multiply
+    const int window = bits <= 16 ? 1 : (bits <= 128 ? 3 : 5);
+    Number odd_powers[1 << 4]; // base^1, base^3, ..., base^(2^window - 1)
+    odd_powers[0] = base;
+    if (window > 1) {
+        Number base_squared;
+        SqrMod(base_squared, base);
+        for (int k = 1; k < (1 << (window - 1)); k++) {
+            MulMod(odd_powers[k], odd_powers[k - 1], base_squared);
+        }
+    }
+
+    Number result;
+    bool first = true;
+    long i = bits - 1;
+    while (i >= 0) {
+        if (!NTL::bit(exponent, i)) {
+            SqrMod(result, result);
+            i--;
+            continue;
+        }
+
+        // Take the longest window [l, i] of at most window bits that ends with a 1
+        long l = std::max(i - window + 1, 0L);
+        while (!NTL::bit(exponent, l)) {
+            l++;
+        }
+        int value = 0;
+        for (long b = i; b >= l; b--) {
+            value = (value << 1) | NTL::bit(exponent, b);
+        }
+
+        if (first) {
+            result = odd_powers[value >> 1];
+            first = false;
+        } else {
+            for (long s = i; s >= l; s--) {
+                SqrMod(result, result);
+            }
+            MulMod(result, result, odd_powers[value >> 1]);
+        }
+        i = l - 1;
+    }
+    dest = result;
+}
+
+// Method to compute *dest[i] = *a[i] * *b[i] mod p for i < n
+template<int Limbs>
+void MontgomeryBackend<Limbs>::BatchMulMod(Number *const *dest, const Number *const *a, const Number *const *b,
+                                           size_t n) const {
+    for (size_t i = 0; i < n; i++) {
+        MulMod(*dest[i], *a[i], *b[i]);
+    }
+}
+
+// Method to compute *dest[i] = *base[i]^exponent mod p for i < n
+template<int Limbs>
+void MontgomeryBackend<Limbs>::BatchPowerMod(Number *const *dest, const Number *const *base,
+                                             const NTL::ZZ &exponent, size_t n) const {
+    for (size_t i = 0; i < n; i++) {
+        PowerMod(*dest[i], *base[i], exponent);
+    }
+}
+
+// Method to compute dest[i] = a[i] * b[i] mod p for i < n on plain residues of limbs limbs
+template<int Limbs>
+void MontgomeryBackend<Limbs>::BatchMulModLimbs(uint64 *const *dest, const uint64 *const *a, const uint64 *const *b,
+                                                size_t n, uint32 limbs) const {
+    Number x, y;
+    for (size_t i = 0; i < n; i++) {
+        LoadLimbs(x, a[i], limbs);
+        LoadLimbs(y, b[i], limbs);
+        // a * R^2 / R is a in Montgomery form, and a * R * b / R the plain product
+        MulMod(x, x, r2_);
+        MulMod(x, x, y);
+        StoreLimbs(dest[i], x, limbs);
+    }
+}
+
+// Method to compute dest[i] = base[i]^exponent mod p for i < n on plain residues of limbs limbs
+template<int Limbs>
+void MontgomeryBackend<Limbs>::BatchPowerModLimbs(uint64 *const *dest, const uint64 *const *base,
+                                                  const NTL::ZZ &exponent, size_t n, uint32 limbs) const {
+    // A product with the plain 1 leaves Montgomery form
+    Number plain_one{};
+    plain_one.limbs[0] = 1;
+    Number x;
+    for (size_t i = 0; i < n; i++) {
+        LoadLimbs(x, base[i], limbs);
+        MulMod(x, x, r2_);
+        PowerMod(x, x, exponent);
+        MulMod(x, x, plain_one);
+        StoreLimbs(dest[i], x, limbs);
+    }
+}
+
+// Method to copy a plain residue of limbs limbs into dest
+template<int Limbs>
+void MontgomeryBackend<Limbs>::LoadLimbs(Number &dest, const uint64 *src, uint32 limbs) {
+    uint32 count = std::min<uint32>(limbs, Limbs);
+    std::copy(src, src + count, dest.limbs);
+    std::fill(dest.limbs + count, dest.limbs + Limbs, 0);
+}
+
+// Method to copy a plain residue into limbs limbs of dest
+template<int Limbs>
+void MontgomeryBackend<Limbs>::StoreLimbs(uint64 *dest, const Number &src, uint32 limbs) {
+    uint32 count = std::min<uint32>(limbs, Limbs);
+    std::copy(src.limbs, src.limbs + count, dest);
+    std::fill(dest + count, dest + limbs, 0);
+}
+
+// Function to get the number of limbs of the Montgomery backend instantiated for a modulus
+// of the given size, 0 if there is none
+int MontgomeryLimbsForBits(long modulus_bits) {
+    long limbs = (modulus_bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    switch (limbs) {
+        case 20:
+        case 36:
+        case 52:
+            return (int) limbs;
+        default:
+            return 0;
+    }
+}
+
+template
+class MontgomeryBackend<20>;
+
+template
+class MontgomeryBackend<36>;
+
+template
+class MontgomeryBackend<52>;
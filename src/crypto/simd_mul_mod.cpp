@@ -0,0 +1,456 @@
+#include "crypto/simd_mul_mod.h"
+
+#include <gmp.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OTMPSI_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// The digits are split from BytesFromZZ output, which is little-endian
+static_assert(std::endian::native == std::endian::little, "SimdMulMod requires a little-endian host");
+
+// The overloads on limbs hand the residues to GMP as they are
+static_assert(std::is_same_v<mp_limb_t, uint64> && GMP_NAIL_BITS == 0, "SimdMulMod requires 64-bit GMP limbs");
+
+const int ifmaRadix = 52;
+const int avx2Radix = 26;
+
+// Most digits of a number for each radix, so the kernels can keep their accumulators on the stack
+const int ifmaMaxDigits = (simdMaxModulusBits + 2 + ifmaRadix - 1) / ifmaRadix;
+const int avx2MaxDigits = (simdMaxModulusBits + 2 + avx2Radix - 1) / avx2Radix;
+
+#ifdef OTMPSI_SIMD_X86
+
+// Montgomery products of eight lanes with 52-bit digits. The low and high halves of the partial products
+// go to separate accumulators, so consecutive multiply-adds do not wait for each other. Every digit
+// of the double-length product sums at most 4 * digits partial products below 2^52, which cannot overflow
+__attribute__((target("avx512f,avx512ifma")))
+static void MontMulAvx512Ifma(uint64 *dest, const uint64 *a, const uint64 *b, const uint64 *p, uint64 k0, int n) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i mask = _mm512_set1_epi64((1ULL << ifmaRadix) - 1);
+    const __m512i k = _mm512_set1_epi64(k0);
+    // The shifts use the zero-masked form, GCC 12 warns about the undefined source of the unmasked one
+    const __mmask8 all = 0xff;
+    __m512i lo[2 * ifmaMaxDigits + 1];
+    __m512i hi[2 * ifmaMaxDigits + 1];
+    for (int j = 0; j <= 2 * n; j++) {
+        lo[j] = zero;
+        hi[j] = zero;
+    }
+
+    for (int i = 0; i < n; i++) {
+        __m512i bi = _mm512_loadu_si512(b + i * SimdMulMod::kLanes);
+        for (int j = 0; j < n; j++) {
+            __m512i aj = _mm512_loadu_si512(a + j * SimdMulMod::kLanes);
+            lo[i + j] = _mm512_madd52lo_epu64(lo[i + j], aj, bi);
+            hi[i + j + 1] = _mm512_madd52hi_epu64(hi[i + j + 1], aj, bi);
+        }
+
+        // Add the multiple m of p that clears digit i, only the low 52 bits of digit i matter for m
+        __m512i ti = _mm512_add_epi64(lo[i], hi[i]);
+        __m512i m = _mm512_madd52lo_epu64(zero, ti, k);
+        ti = _mm512_madd52lo_epu64(ti, _mm512_set1_epi64(p[0]), m);
+        hi[i + 1] = _mm512_madd52hi_epu64(hi[i + 1], _mm512_set1_epi64(p[0]), m);
+        for (int j = 1; j < n; j++) {
+            __m512i pj = _mm512_set1_epi64(p[j]);
+            lo[i + j] = _mm512_madd52lo_epu64(lo[i + j], pj, m);
+            hi[i + j + 1] = _mm512_madd52hi_epu64(hi[i + j + 1], pj, m);
+        }
+        lo[i + 1] = _mm512_add_epi64(lo[i + 1], _mm512_maskz_srli_epi64(all, ti, ifmaRadix));
+    }
+
+    // The upper half is the result below 2p < R, normalize its digits for the next product
+    __m512i carry = zero;
+    for (int j = n; j < 2 * n; j++) {
+        __m512i digit = _mm512_add_epi64(_mm512_add_epi64(lo[j], hi[j]), carry);
+        carry = _mm512_maskz_srli_epi64(all, digit, ifmaRadix);
+        _mm512_storeu_si512(dest + (j - n) * SimdMulMod::kLanes, _mm512_and_si512(digit, mask));
+    }
+}
+
+// Montgomery products of eight lanes with 26-bit digits, as two halves of four lanes. The 32x32-bit
+// multiplies give full products below 2^52, at most 2 * digits of them add up in a digit
+__attribute__((target("avx2")))
+static void MontMulAvx2(uint64 *dest, const uint64 *a, const uint64 *b, const uint64 *p, uint64 k0, int n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask = _mm256_set1_epi64x((1LL << avx2Radix) - 1);
+    const __m256i k = _mm256_set1_epi64x(k0);
+    __m256i lo[2 * avx2MaxDigits + 1];
+    __m256i hi[2 * avx2MaxDigits + 1];
+    for (int j = 0; j <= 2 * n; j++) {
+        lo[j] = zero;
+        hi[j] = zero;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uint64 *b_digit = b + i * SimdMulMod::kLanes;
+        __m256i bi_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b_digit));
+        __m256i bi_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b_digit + 4));
+        for (int j = 0; j < n; j++) {
+            const uint64 *a_digit = a + j * SimdMulMod::kLanes;
+            __m256i aj_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_digit));
+            __m256i aj_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_digit + 4));
+            lo[i + j] = _mm256_add_epi64(lo[i + j], _mm256_mul_epu32(aj_lo, bi_lo));
+            hi[i + j] = _mm256_add_epi64(hi[i + j], _mm256_mul_epu32(aj_hi, bi_hi));
+        }
+
+        // Add the multiple m of p that clears digit i, only the low 26 bits of digit i matter for m
+        __m256i m_lo = _mm256_and_si256(_mm256_mul_epu32(lo[i], k), mask);
+        __m256i m_hi = _mm256_and_si256(_mm256_mul_epu32(hi[i], k), mask);
+        for (int j = 0; j < n; j++) {
+            __m256i pj = _mm256_set1_epi64x(p[j]);
+            lo[i + j] = _mm256_add_epi64(lo[i + j], _mm256_mul_epu32(pj, m_lo));
+            hi[i + j] = _mm256_add_epi64(hi[i + j], _mm256_mul_epu32(pj, m_hi));
+        }
+        lo[i + 1] = _mm256_add_epi64(lo[i + 1], _mm256_srli_epi64(lo[i], avx2Radix));
+        hi[i + 1] = _mm256_add_epi64(hi[i + 1], _mm256_srli_epi64(hi[i], avx2Radix));
+    }
+
+    // The upper half is the result below 2p < R, normalize its digits for the next product
+    for (int j = n; j < 2 * n; j++) {
+        lo[j + 1] = _mm256_add_epi64(lo[j + 1], _mm256_srli_epi64(lo[j], avx2Radix));
+        hi[j + 1] = _mm256_add_epi64(hi[j + 1], _mm256_srli_epi64(hi[j], avx2Radix));
+        uint64 *d = dest + (j - n) * SimdMulMod::kLanes;
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), _mm256_and_si256(lo[j], mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 4), _mm256_and_si256(hi[j], mask));
+    }
+}
+
+#endif // OTMPSI_SIMD_X86
+
+// Function to split little-endian bytes into n digits of radix bits, every stride-th word of digits. A digit
+// is one unaligned 64-bit read, so bytes must have 8 readable bytes past the digits
+static void SplitDigits(uint64 *digits, size_t stride, const uint8 *bytes, int radix, int n) {
+    const uint64 mask = (1ULL << radix) - 1;
+    for (int d = 0; d < n; d++) {
+        long bit = static_cast<long>(d) * radix;
+        uint64 word;
+        std::memcpy(&word, bytes + bit / 8, sizeof(word));
+        digits[d * stride] = (word >> (bit % 8)) & mask;
+    }
+}
+
+// Function to join n normalized digits of radix bits, every stride-th word of digits, into little-endian
+// bytes. bytes must have 8 writable bytes past the digits
+static void JoinDigits(uint8 *bytes, long num_bytes, const uint64 *digits, size_t stride, int radix, int n) {
+    std::memset(bytes, 0, num_bytes + sizeof(uint64));
+    for (int d = 0; d < n; d++) {
+        long bit = static_cast<long>(d) * radix;
+        uint64 word;
+        std::memcpy(&word, bytes + bit / 8, sizeof(word));
+        word |= digits[d * stride] << (bit % 8);
+        std::memcpy(bytes + bit / 8, &word, sizeof(word));
+    }
+}
+
+// Function to get the digit radix of the kernel of an instruction set, 0 if the CPU lacks it
+static int SelectRadix(const std::string &isa) {
+    if (isa != simdMulModAuto && isa != simdMulModAvx512Ifma && isa != simdMulModAvx2 && isa != simdMulModNone) {
+        throw std::invalid_argument("Unknown SIMD instruction set " + isa);
+    }
+#ifdef OTMPSI_SIMD_X86
+    __builtin_cpu_init();
+    if ((isa == simdMulModAuto || isa == simdMulModAvx512Ifma) && __builtin_cpu_supports("avx512ifma")) {
+        return ifmaRadix;
+    }
+    if (isa == simdMulModAvx2 && __builtin_cpu_supports("avx2")) {
+        return avx2Radix;
+    }
+#endif
+    return 0;
+}
+
+// Constructor that takes the modulus p and the name of the instruction set
+SimdMulMod::SimdMulMod(const NTL::ZZ &p, const std::string &isa) : p_(p), isa_(Isa::none) {
+    p_limbs_.resize((NTL::NumBits(p) + 63) / 64);
+    NTL::BytesFromZZ(reinterpret_cast<uint8 *>(p_limbs_.data()), p, p_limbs_.size() * sizeof(uint64));
+
+    radix_ = SelectRadix(isa);
+    if (radix_ == 0 || !NTL::IsOdd(p) || p == 1 || NTL::NumBits(p) > simdMaxModulusBits) {
+        radix_ = 0;
+        return;
+    }
+    isa_ = radix_ == ifmaRadix ? Isa::avx512ifma : Isa::avx2;
+
+    // R > 4p keeps the results of products of operands below 2p below 2p
+    digits_ = (NTL::NumBits(p) + 2 + radix_ - 1) / radix_;
+    bytes_ = (static_cast<long>(digits_) * radix_ + 7) / 8;
+
+    std::vector<uint8> bytes(bytes_ + sizeof(uint64));
+    NTL::BytesFromZZ(bytes.data(), p, bytes_);
+    p_digits_.resize(digits_);
+    SplitDigits(p_digits_.data(), 1, bytes.data(), radix_, digits_);
+
+    // Newton iteration for p^-1 mod 2^64, every step doubles the number of correct bits
+    uint64 inv = p_digits_[0];
+    for (int i = 0; i < 6; i++) {
+        inv *= 2 - p_digits_[0] * inv;
+    }
+    k0_ = -inv & ((1ULL << radix_) - 1);
+
+    r2_.resize(digits_ * kLanes);
+    Broadcast(r2_.data(), 2);
+}
+
+// Method to get the name of the instruction set in use
+const std::string &SimdMulMod::isa() const {
+    switch (isa_) {
+        case Isa::avx512ifma:
+            return simdMulModAvx512Ifma;
+        case Isa::avx2:
+            return simdMulModAvx2;
+        default:
+            return simdMulModNone;
+    }
+}
+
+// Method to compute *dest[i] = *a[i] * *b[i] mod p for i < n
+void SimdMulMod::MulMod(NTL::ZZ *const *dest, const NTL::ZZ *const *a, const NTL::ZZ *const *b, size_t n) const {
+    if (isa_ == Isa::none) {
+        for (size_t i = 0; i < n; i++) {
+            NTL::MulMod(*dest[i], *a[i], *b[i], p_);
+        }
+        return;
+    }
+    MulModLanes(dest, a, b, n, 0);
+}
+
+// Method to compute *dest[i] = *base[i]^exponent mod p for i < n
+void SimdMulMod::PowerMod(NTL::ZZ *const *dest, const NTL::ZZ *const *base, const NTL::ZZ &exponent,
+                          size_t n) const {
+    long bits = NTL::NumBits(exponent);
+    if (isa_ == Isa::none || bits > simdMaxExponentBits || NTL::sign(exponent) < 0) {
+        for (size_t i = 0; i < n; i++) {
+            NTL::PowerMod(*dest[i], *base[i], exponent, p_);
+        }
+        return;
+    }
+    if (bits <= 1) {
+        for (size_t i = 0; i < n; i++) {
+            if (bits == 0) {
+                *dest[i] = 1;
+            } else if (dest[i] != base[i]) {
+                *dest[i] = *base[i];
+            }
+        }
+        return;
+    }
+    PowerModLanes(dest, base, exponent, n, 0);
+}
+
+// Method to compute dest[i] = a[i] * b[i] mod p for i < n on residues of limbs limbs
+void SimdMulMod::MulMod(uint64 *const *dest, const uint64 *const *a, const uint64 *const *b, size_t n,
+                        uint32 limbs) const {
+    CheckLimbs(limbs);
+    if (isa_ == Isa::none) {
+        std::vector<uint64> t(3 * limbs + 1);
+        for (size_t i = 0; i < n; i++) {
+            MulModMpn(dest[i], a[i], b[i], limbs, t.data());
+        }
+        return;
+    }
+    MulModLanes(dest, a, b, n, limbs);
+}
+
+// Method to compute dest[i] = base[i]^exponent mod p for i < n on residues of limbs limbs
+void SimdMulMod::PowerMod(uint64 *const *dest, const uint64 *const *base, const NTL::ZZ &exponent, size_t n,
+                          uint32 limbs) const {
+    CheckLimbs(limbs);
+    if (NTL::sign(exponent) < 0) {
+        throw std::invalid_argument("SimdMulMod::PowerMod on limbs takes no negative exponent");
+    }
+    long bits = NTL::NumBits(exponent);
+    if (bits <= 1) {
+        for (size_t i = 0; i < n; i++) {
+            if (bits == 0) {
+                std::fill(dest[i], dest[i] + limbs, 0);
+                dest[i][0] = 1;
+            } else if (dest[i] != base[i]) {
+                std::copy(base[i], base[i] + limbs, dest[i]);
+            }
+        }
+        return;
+    }
+    if (isa_ != Isa::none && bits <= simdMaxExponentBits) {
+        PowerModLanes(dest, base, exponent, n, limbs);
+        return;
+    }
+
+    // Square-and-multiply on GMP, the base is copied first because dest may be it
+    std::vector<uint64> x(limbs), t(3 * limbs + 1);
+    for (size_t i = 0; i < n; i++) {
+        std::copy(base[i], base[i] + limbs, x.data());
+        std::copy(x.begin(), x.end(), dest[i]);
+        for (long bit = bits - 2; bit >= 0; bit--) {
+            MulModMpn(dest[i], dest[i], dest[i], limbs, t.data());
+            if (NTL::bit(exponent, bit)) {
+                MulModMpn(dest[i], dest[i], x.data(), limbs, t.data());
+            }
+        }
+    }
+}
+
+// Method to run the kernels on n residues of type T, NTL::ZZ or limbs limbs of uint64
+template<typename T>
+void SimdMulMod::MulModLanes(T *const *dest, const T *const *a, const T *const *b, size_t n, uint32 limbs) const {
+    std::vector<uint64> x(digits_ * kLanes), y(digits_ * kLanes), words(ScratchWords(limbs));
+    for (size_t i = 0; i < n; i += kLanes) {
+        size_t count = std::min<size_t>(kLanes, n - i);
+        Load(x.data(), a + i, count, limbs, words.data());
+        Load(y.data(), b + i, count, limbs, words.data());
+        // a * b / R, then * R^2 / R
+        MontMul(x.data(), x.data(), y.data());
+        MontMul(x.data(), x.data(), r2_.data());
+        Store(dest + i, x.data(), count, limbs, words.data());
+    }
+}
+
+// Method to run the kernels on n exponentiations of residues of type T, for exponents of 2 to
+// simdMaxExponentBits bits
+template<typename T>
+void SimdMulMod::PowerModLanes(T *const *dest, const T *const *base, const NTL::ZZ &exponent, size_t n,
+                               uint32 limbs) const {
+    long bits = NTL::NumBits(exponent);
+
+    // Square-and-multiply on the plain residues, every product adds a factor R^-1. Track the power of R
+    // in the result and remove it with one last product
+    long r_power = 0;
+    for (long bit = bits - 2; bit >= 0; bit--) {
+        r_power = 2 * r_power - 1;
+        if (NTL::bit(exponent, bit)) {
+            r_power--;
+        }
+    }
+    std::vector<uint64> correction(digits_ * kLanes);
+    Broadcast(correction.data(), 1 - r_power);
+
+    std::vector<uint64> x(digits_ * kLanes), y(digits_ * kLanes), words(ScratchWords(limbs));
+    for (size_t i = 0; i < n; i += kLanes) {
+        size_t count = std::min<size_t>(kLanes, n - i);
+        Load(x.data(), base + i, count, limbs, words.data());
+        y = x;
+        for (long bit = bits - 2; bit >= 0; bit--) {
+            MontMul(y.data(), y.data(), y.data());
+            if (NTL::bit(exponent, bit)) {
+                MontMul(y.data(), y.data(), x.data());
+            }
+        }
+        MontMul(y.data(), y.data(), correction.data());
+        Store(dest + i, y.data(), count, limbs, words.data());
+    }
+}
+
+// Method to transpose count residues into the lanes of dest, the other lanes are zeroed
+void SimdMulMod::Load(uint64 *dest, const NTL::ZZ *const *src, size_t count, uint32, uint64 *words) const {
+    auto *bytes = reinterpret_cast<uint8 *>(words);
+    for (size_t l = 0; l < kLanes; l++) {
+        if (l < count) {
+            NTL::BytesFromZZ(bytes, *src[l], bytes_);
+            SplitDigits(dest + l, kLanes, bytes, radix_, digits_);
+        } else {
+            for (int d = 0; d < digits_; d++) {
+                dest[d * kLanes + l] = 0;
+            }
+        }
+    }
+}
+
+// Method to transpose count residues of limbs limbs into the lanes of dest, the other lanes are zeroed
+void SimdMulMod::Load(uint64 *dest, const uint64 *const *src, size_t count, uint32 limbs, uint64 *words) const {
+    size_t num_words = ScratchWords(limbs);
+    for (size_t l = 0; l < kLanes; l++) {
+        if (l < count) {
+            std::copy(src[l], src[l] + limbs, words);
+            std::fill(words + limbs, words + num_words, 0);
+            SplitDigits(dest + l, kLanes, reinterpret_cast<const uint8 *>(words), radix_, digits_);
+        } else {
+            for (int d = 0; d < digits_; d++) {
+                dest[d * kLanes + l] = 0;
+            }
+        }
+    }
+}
+
+// Method to transpose count lanes of src, which are below 2p, back into residues
+void SimdMulMod::Store(NTL::ZZ *const *dest, const uint64 *src, size_t count, uint32, uint64 *words) const {
+    auto *bytes = reinterpret_cast<uint8 *>(words);
+    for (size_t l = 0; l < count; l++) {
+        JoinDigits(bytes, bytes_, src + l, kLanes, radix_, digits_);
+        NTL::ZZFromBytes(*dest[l], bytes, bytes_);
+        if (*dest[l] >= p_) {
+            *dest[l] -= p_;
+        }
+    }
+}
+
+// Method to transpose count lanes of src, which are below 2p, back into residues of limbs limbs
+void SimdMulMod::Store(uint64 *const *dest, const uint64 *src, size_t count, uint32 limbs, uint64 *words) const {
+    size_t num_words = ScratchWords(limbs);
+    const size_t p_size = p_limbs_.size();
+    for (size_t l = 0; l < count; l++) {
+        std::fill(words, words + num_words, 0);
+        JoinDigits(reinterpret_cast<uint8 *>(words), bytes_, src + l, kLanes, radix_, digits_);
+        // A lane below 2p is at least p if it has limbs above those of p or its low limbs are
+        bool reduce = std::any_of(words + p_size, words + num_words, [](uint64 w) { return w != 0; }) ||
+                      mpn_cmp(words, p_limbs_.data(), p_size) >= 0;
+        if (reduce) {
+            mpn_sub(words, words, num_words, p_limbs_.data(), p_size);
+        }
+        std::copy(words, words + limbs, dest[l]);
+    }
+}
+
+// Method to get the scratch words of Load and Store
+size_t SimdMulMod::ScratchWords(uint32 limbs) const {
+    size_t bytes = std::max<size_t>(bytes_, static_cast<size_t>(limbs) * sizeof(uint64));
+    return (bytes + sizeof(uint64) + sizeof(uint64) - 1) / sizeof(uint64);
+}
+
+// Method to compute dest = a * b mod p on residues of limbs limbs with GMP. The residues are below p,
+// so only their low limbs of the size of p are multiplied
+void SimdMulMod::MulModMpn(uint64 *dest, const uint64 *a, const uint64 *b, uint32 limbs, uint64 *t) const {
+    const auto p_size = static_cast<mp_size_t>(p_limbs_.size());
+    if (a == b) {
+        mpn_sqr(t, a, p_size);
+    } else {
+        mpn_mul_n(t, a, b, p_size);
+    }
+    mpn_tdiv_qr(t + 2 * p_size, dest, 0, t, 2 * p_size, p_limbs_.data(), p_size);
+    std::fill(dest + p_size, dest + limbs, 0);
+}
+
+// Method to throw unless p fits into residues of limbs limbs
+void SimdMulMod::CheckLimbs(uint32 limbs) const {
+    if (limbs < p_limbs_.size()) {
+        throw std::invalid_argument("Residues of " + std::to_string(limbs) + " limbs cannot hold a modulus of " +
+                                    std::to_string(NTL::NumBits(p_)) + " bits");
+    }
+}
+
+// Method to set every lane of dest to R^r_power mod p
+void SimdMulMod::Broadcast(uint64 *dest, long r_power) const {
+    NTL::ZZ r = NTL::PowerMod((NTL::ZZ(1) << (static_cast<long>(digits_) * radix_)) % p_, r_power, p_);
+    std::vector<uint8> bytes(bytes_ + sizeof(uint64));
+    NTL::BytesFromZZ(bytes.data(), r, bytes_);
+    for (size_t l = 0; l < kLanes; l++) {
+        SplitDigits(dest + l, kLanes, bytes.data(), radix_, digits_);
+    }
+}
+
+// Method to compute the Montgomery products dest = a * b / R mod p of all lanes
+void SimdMulMod::MontMul(uint64 *dest, const uint64 *a, const uint64 *b) const {
+#ifdef OTMPSI_SIMD_X86
+    if (isa_ == Isa::avx512ifma) {
+        MontMulAvx512Ifma(dest, a, b, p_digits_.data(), k0_, digits_);
+    } else {
+        MontMulAvx2(dest, a, b, p_digits_.data(), k0_, digits_);
+    }
+#endif
+}
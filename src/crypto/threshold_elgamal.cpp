@@ -1,55 +1,247 @@
 #include "crypto/threshold_elgamal.h"
 
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "crypto/ciphertext_array.h"
+
 // Method to find square root of a ciphertext. The function assigns src to dest if src is not a square in the finite field
-void KeyHolder::SquareRoot(Ciphertext &dest, const Ciphertext &src) {
-    NTL::ZZ root1, root2;
-    NTL::SqrRootMod(root1, src.first, p_);
-    NTL::SqrRootMod(root2, src.second, p_);
+template<typename Backend>
+void BasicKeyHolder<Backend>::SquareRoot(Ciphertext &dest, const Ciphertext &src) {
+    NTL::ZZ c1, c2, root1, root2;
+    backend_.ToZz(c1, src.first);
+    backend_.ToZz(c2, src.second);
+    NTL::SqrRootMod(root1, c1, p_);
+    NTL::SqrRootMod(root2, c2, p_);
 
     if (root1 == 0 || root2 == 0) {
         dest = src;
     } else {
-        dest.first = root1;
-        dest.second = root2;
+        backend_.FromZz(dest.first, root1);
+        backend_.FromZz(dest.second, root2);
     }
 }
 
 // Method to encrypt a plaintext message using the ElGamal encryption scheme
-void KeyHolder::Encrypt(Ciphertext &ciphertext, const NTL::ZZ &plaintext) {
-    // Generate a random number that is coprime with p
+template<typename Backend>
+void BasicKeyHolder<Backend>::Encrypt(Ciphertext &ciphertext, const Number &plaintext) {
     NTL::ZZ random_num;
-    NTL::RandomBnd(random_num, p_);
+    RandomExponent(random_num);
+    // Compute the first component of the ciphertext as c1 = alpha^random_num mod p
+    if (alpha_table_.ready()) {
+        alpha_table_.PowerMod(backend_, ciphertext.first, random_num);
+    } else {
+        backend_.PowerMod(ciphertext.first, alpha_, random_num);
+    }
+    // Compute the second component of the ciphertext as c2 = beta^random_num * plaintext mod p
+    if (beta_table_.ready()) {
+        beta_table_.PowerMod(backend_, ciphertext.second, random_num);
+    } else {
+        backend_.PowerMod(ciphertext.second, beta_, random_num);
+    }
+    backend_.MulMod(ciphertext.second, ciphertext.second, plaintext);
+}
+
+// Method to install a pool of encryptions of 1 for EncryptOne
+template<typename Backend>
+void BasicKeyHolder<Backend>::SetRerandomizerPool(std::vector<Ciphertext> pool, uint32 subset_size) {
+    rerand_pool_ = std::move(pool);
+    rerand_subset_size_ = std::min<uint32>(subset_size, rerand_pool_.size());
+}
+
+// Method to produce a fresh encryption of 1, from the rerandomizer pool when one is installed
+template<typename Backend>
+void BasicKeyHolder<Backend>::EncryptOne(Ciphertext &ciphertext) {
+    if (rerand_subset_size_ == 0) {
+        Encrypt(ciphertext, one_);
+        return;
+    }
+
+    // Draw subset_size distinct pool indices with a partial Fisher-Yates shuffle
+    thread_local std::vector<uint32> indices;
+    if (indices.size() != rerand_pool_.size()) {
+        indices.resize(rerand_pool_.size());
+        std::iota(indices.begin(), indices.end(), 0);
+    }
+    ChaChaStream &random = ChaChaStream::ThreadLocal();
+    for (uint32 i = 0; i < rerand_subset_size_; i++) {
+        std::swap(indices[i], indices[i + random.RandomBnd(static_cast<long>(indices.size() - i))]);
+    }
+
+    ciphertext = rerand_pool_[indices[0]];
+    for (uint32 i = 1; i < rerand_subset_size_; i++) {
+        Mul(ciphertext, ciphertext, rerand_pool_[indices[i]]);
+    }
+}
+
+// Method to draw the random exponent of an encryption
+template<typename Backend>
+void BasicKeyHolder<Backend>::RandomExponent(NTL::ZZ &random_num) {
+    // Generate a random number that is coprime with p, either below p or of short_exponent_bits_ bits.
+    // Every thread draws from its own stream, so parallel encryptions do not contend on a generator
+    ChaChaStream &random = ChaChaStream::ThreadLocal();
+    if (short_exponent_bits_ > 0) {
+        random.RandomBits(random_num, short_exponent_bits_);
+    } else {
+        random.RandomBnd(random_num, p_);
+    }
     while (!CoprimeWithPhiP(random_num) || random_num < 3 || random_num > p_ - 3) {
         random_num += 1;
     }
-    // Compute the first component of the ciphertext as c1 = alpha^random_num mod p
-    NTL::PowerMod(ciphertext.first, alpha_, random_num, p_);
-    // Compute the second component of the ciphertext as c2 = beta^random_num * plaintext mod p
-    NTL::PowerMod(ciphertext.second, beta_, random_num, p_);
-    NTL::MulMod(ciphertext.second, ciphertext.second, plaintext, p_);
+}
+
+// Method to replace the secret key, the public key becomes the local share alpha^a
+template<typename Backend>
+void BasicKeyHolder<Backend>::SetSecretKey(const NTL::ZZ &a) {
+    a_ = a;
+    neg_a_ = p_ - 1 - a_;
+    backend_.PowerMod(beta_, alpha_, a_);
+}
+
+// Method to use short random exponents of the given length in Encrypt, bits = 0 draws them below p
+template<typename Backend>
+void BasicKeyHolder<Backend>::SetShortExponentBits(long bits) {
+    short_exponent_bits_ = (bits > 0 && bits < NTL::NumBits(p_)) ? bits : 0;
+}
+
+// Method to build the fixed-base tables for alpha and beta, window_bits = 0 disables them
+template<typename Backend>
+void BasicKeyHolder<Backend>::PrecomputeFixedBases(long window_bits) {
+    // The tables only need to cover the exponents Encrypt draws. The +1 covers the carry of the
+    // coprimality search in RandomExponent
+    long exponent_bits = short_exponent_bits_ > 0 ? short_exponent_bits_ + 1 : NTL::NumBits(p_);
+    alpha_table_.Precompute(backend_, alpha_, exponent_bits, window_bits);
+    beta_table_.Precompute(backend_, beta_, exponent_bits, window_bits);
+}
+
+// Method to get the memory used by the fixed-base tables
+template<typename Backend>
+uint64 BasicKeyHolder<Backend>::FixedBaseTableBytes() const {
+    return alpha_table_.TableBytes(backend_) + beta_table_.TableBytes(backend_);
+}
+
+// Method to multiply n pairs of ciphertexts, dest[i] = src1[i] * src2[i]
+template<typename Backend>
+void BasicKeyHolder<Backend>::MulBatch(Ciphertext *dest, const Ciphertext *src1, const Ciphertext *src2, size_t n) {
+    // Gather the c1 products, then the c2 products
+    std::vector<Number *> d(2 * n);
+    std::vector<const Number *> a(2 * n), b(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = &dest[i].first;
+        a[i] = &src1[i].first;
+        b[i] = &src2[i].first;
+        d[n + i] = &dest[i].second;
+        a[n + i] = &src1[i].second;
+        b[n + i] = &src2[i].second;
+    }
+    backend_.BatchMulMod(d.data(), a.data(), b.data(), 2 * n);
+}
+
+// Method to multiply n pairs of ciphertexts given by pointers, *dest[i] = *src1[i] * *src2[i]
+template<typename Backend>
+void BasicKeyHolder<Backend>::MulBatch(Ciphertext *const *dest, const Ciphertext *const *src1,
+                                       const Ciphertext *const *src2, size_t n) {
+    std::vector<Number *> d(2 * n);
+    std::vector<const Number *> a(2 * n), b(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = &dest[i]->first;
+        a[i] = &src1[i]->first;
+        b[i] = &src2[i]->first;
+        d[n + i] = &dest[i]->second;
+        a[n + i] = &src1[i]->second;
+        b[n + i] = &src2[i]->second;
+    }
+    backend_.BatchMulMod(d.data(), a.data(), b.data(), 2 * n);
+}
+
+// Method to exponentiate n ciphertexts given by pointers with a common small exponent
+template<typename Backend>
+void BasicKeyHolder<Backend>::PowerBatch(Ciphertext *const *dest, const Ciphertext *const *src,
+                                         const NTL::ZZ &exponent, size_t n) {
+    std::vector<Number *> d(2 * n);
+    std::vector<const Number *> base(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = &dest[i]->first;
+        base[i] = &src[i]->first;
+        d[n + i] = &dest[i]->second;
+        base[n + i] = &src[i]->second;
+    }
+    backend_.BatchPowerMod(d.data(), base.data(), exponent, 2 * n);
+}
+
+// Method to multiply n ciphertexts of arrays in place on their limbs, dest_index[i] of dest by src_index[i] of src
+template<typename Backend>
+void BasicKeyHolder<Backend>::MulBatch(CiphertextArray &dest, const size_t *dest_index, const CiphertextArray &src,
+                                       const size_t *src_index, size_t n) {
+    if (dest.limbs() != src.limbs()) {
+        throw std::invalid_argument("Ciphertext arrays of " + std::to_string(dest.limbs()) + " and " +
+                                    std::to_string(src.limbs()) + " limbs cannot be multiplied");
+    }
+    std::vector<uint64 *> d(2 * n);
+    std::vector<const uint64 *> a(2 * n), b(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = dest.c1_limbs(dest_index[i]);
+        a[i] = d[i];
+        b[i] = src.c1_limbs(src_index[i]);
+        d[n + i] = dest.c2_limbs(dest_index[i]);
+        a[n + i] = d[n + i];
+        b[n + i] = src.c2_limbs(src_index[i]);
+    }
+    backend_.BatchMulModLimbs(d.data(), a.data(), b.data(), 2 * n, dest.limbs());
+}
+
+// Method to exponentiate n ciphertexts of an array in place on their limbs with a common small exponent
+template<typename Backend>
+void BasicKeyHolder<Backend>::PowerBatch(CiphertextArray &array, const size_t *index, const NTL::ZZ &exponent,
+                                         size_t n) {
+    std::vector<uint64 *> d(2 * n);
+    std::vector<const uint64 *> base(2 * n);
+    for (size_t i = 0; i < n; i++) {
+        d[i] = array.c1_limbs(index[i]);
+        base[i] = d[i];
+        d[n + i] = array.c2_limbs(index[i]);
+        base[n + i] = d[n + i];
+    }
+    backend_.BatchPowerModLimbs(d.data(), base.data(), exponent, 2 * n, array.limbs());
 }
 
 // Method to fully decrypt a ciphertext using decryption shares from multiple key holders
-void KeyHolder::FullyDecrypt(NTL::ZZ &plaintext, const std::vector<NTL::ZZ> &decryption_shares, const NTL::ZZ &c2) {
+template<typename Backend>
+void BasicKeyHolder<Backend>::FullyDecrypt(Number &plaintext, const std::vector<Number> &decryption_shares,
+                                           const Number &c2) {
     // Compute the product of all decryption shares
     plaintext = c2;
     for (const auto &it: decryption_shares) {
-        NTL::MulMod(plaintext, plaintext, it, p_);
+        backend_.MulMod(plaintext, plaintext, it);
     }
 }
 
 // Method to check if a number is coprime with phi(p)
-bool KeyHolder::CoprimeWithPhiP(const NTL::ZZ &k) {
+template<typename Backend>
+bool BasicKeyHolder<Backend>::CoprimeWithPhiP(const NTL::ZZ &k) {
     // Check if k is negative
     if (k < 0) {
         return false;
     }
 
     // Check if k is divisible by any prime factor of p-1
-    if (all_of(phi_p_prime_factor_list_.begin(), phi_p_prime_factor_list_.end(),
-               [k](const NTL::ZZ &f) { return k % f == 0; })) {
+    if (std::all_of(phi_p_prime_factor_list_.begin(), phi_p_prime_factor_list_.end(),
+                    [k](const NTL::ZZ &f) { return k % f == 0; })) {
         return false;
     }
 
     return true;
 }
+
+template
+class BasicKeyHolder<NtlBackend>;
+
+template
+class BasicKeyHolder<MontgomeryBackend<20>>;
+
+template
+class BasicKeyHolder<MontgomeryBackend<36>>;
+
+template
+class BasicKeyHolder<MontgomeryBackend<52>>;
@@ -0,0 +1,38 @@
+#include "network/endpoint_factory.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "network/mux_endpoint.h"
+#include "network/tcp_endpoint.h"
+
+#ifdef __linux__
+#include "network/io_uring_endpoint.h"
+#endif
+
+// Function to create the network endpoint selected by options.network_backend, listening on options.port
+std::unique_ptr<Endpoint> NewEndpointFromOptions(const Options &options) {
+    if (options.network_backend == networkBackendIoUring) {
+#ifdef __linux__
+        try {
+            return MultiplexEndpoint(std::make_unique<IoUringEndpoint>(options.port, options.max_in_flight_bytes,
+                                                                       options.zero_copy_send), options);
+        } catch (const std::exception &e) {
+            std::cerr << "io_uring backend unavailable (" << e.what() << "), using TCP" << std::endl;
+        }
+#else
+        std::cerr << "io_uring backend needs Linux, using TCP" << std::endl;
+#endif
+    } else if (options.network_backend != networkBackendTcp) {
+        throw std::invalid_argument("Unknown network backend " + options.network_backend);
+    }
+    return MultiplexEndpoint(std::make_unique<TcpEndpoint>(options.port, options.max_in_flight_bytes), options);
+}
+
+// Function to wrap an endpoint into a MuxEndpoint when options.connections_per_peer is set
+std::unique_ptr<Endpoint> MultiplexEndpoint(std::unique_ptr<Endpoint> endpoint, const Options &options) {
+    if (options.connections_per_peer == 0) {
+        return endpoint;
+    }
+    return std::make_unique<MuxEndpoint>(std::move(endpoint), options.connections_per_peer);
+}
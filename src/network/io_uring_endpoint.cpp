@@ -0,0 +1,488 @@
+#ifdef __linux__
+
+#include "network/io_uring_endpoint.h"
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+// user_data of the read on the wake-up eventfd, requests are pointers and never 1
+const uint64 wakeUserData = 1;
+
+// Function to set up an io_uring instance
+static int IoUringSetup(uint32 entries, io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+// Function to submit queued entries and optionally wait for completions
+static int IoUringEnter(int ring_fd, uint32 to_submit, uint32 min_complete, uint32 flags) {
+    return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+// Function to register resources with an io_uring instance
+static int IoUringRegister(int ring_fd, uint32 opcode, const void *arg, uint32 nr_args) {
+    return (int) syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+// Function to load a ring index written by the kernel
+static inline uint32 LoadAcquire(uint32 *p) {
+    return std::atomic_ref<uint32>(*p).load(std::memory_order_acquire);
+}
+
+// Function to publish a ring index to the kernel
+static inline void StoreRelease(uint32 *p, uint32 v) {
+    std::atomic_ref<uint32>(*p).store(v, std::memory_order_release);
+}
+
+// Constructor that takes a port number, the limit of queued bytes per channel and whether to use zero copy
+IoUringEndpoint::IoUringEndpoint(int port, uint64 max_in_flight_bytes, bool zero_copy)
+        : TcpEndpoint(port, max_in_flight_bytes), zero_copy_(zero_copy) {
+    io_uring_params params{};
+    ring_fd_ = IoUringSetup(ioUringEntries, &params);
+    if (ring_fd_ < 0) {
+        throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+    }
+
+    // Map the submission ring, the completion ring and the submission entries
+    sq_bytes_ = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    cq_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+    }
+    sq_ptr_ = mmap(nullptr, sq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                   IORING_OFF_SQ_RING);
+    cq_ptr_ = single_mmap ? sq_ptr_ : mmap(nullptr, cq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           ring_fd_, IORING_OFF_CQ_RING);
+    sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_SQES);
+    if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes == MAP_FAILED) {
+        close(ring_fd_);
+        throw std::runtime_error(std::string("io_uring mmap failed: ") + std::strerror(errno));
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    auto sq = static_cast<uint8 *>(sq_ptr_);
+    sq_head_ = reinterpret_cast<uint32 *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32 *>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<uint32 *>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<uint32 *>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    auto cq = static_cast<uint8 *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<uint32 *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32 *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32 *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // A sparse table of registered files, sockets are filled in as channels are resolved
+    std::vector<int> fds(ioUringFixedFiles, -1);
+    fixed_files_ = IoUringRegister(ring_fd_, IORING_REGISTER_FILES, fds.data(), fds.size()) == 0;
+
+    wake_fd_ = eventfd(0, EFD_CLOEXEC);
+    uring_channels_.reserve(maxResolvedChannels);
+    io_thread_ = std::thread(&IoUringEndpoint::Run, this);
+}
+
+// Destructor that stops the io thread and unmaps the rings
+IoUringEndpoint::~IoUringEndpoint() {
+    if (io_thread_.joinable()) {
+        stopping_ = true;
+        uint64 one = 1;
+        (void) !write(wake_fd_, &one, sizeof(one));
+        io_thread_.join();
+    }
+    munmap(sqes_, sqes_bytes_);
+    if (cq_ptr_ != sq_ptr_) {
+        munmap(cq_ptr_, cq_bytes_);
+    }
+    munmap(sq_ptr_, sq_bytes_);
+    close(wake_fd_);
+    close(ring_fd_);
+}
+
+// Method to stop the endpoint
+void IoUringEndpoint::Stop() {
+    for (uint32 i = 0; i < uring_channels_.size(); i++) {
+        Flush(ChannelHandle{i});
+    }
+    stopping_ = true;
+    uint64 one = 1;
+    (void) !write(wake_fd_, &one, sizeof(one));
+    io_thread_.join();
+    uring_channels_.clear();
+    TcpEndpoint::Stop();
+}
+
+// Method to resolve the channel of a connected remote endpoint into a handle
+ChannelHandle IoUringEndpoint::GetChannel(const std::string &remote_name) {
+    ChannelHandle handle = TcpEndpoint::GetChannel(remote_name);
+    // The io thread indexes the table while channels are resolved, so it must never reallocate
+    if (handle.index >= uring_channels_.capacity()) {
+        throw std::length_error("Too many resolved channels");
+    }
+    const auto &tcp_channel = resolved_channels_[handle.index];
+
+    auto channel = std::make_unique<IoUringChannel>();
+    channel->shared_memory = tcp_channel->uses_shared_memory();
+    channel->fd = tcp_channel->socket().native_handle();
+    channel->fixed_file = false;
+    if (fixed_files_ && handle.index < ioUringFixedFiles) {
+        io_uring_files_update update{};
+        update.offset = handle.index;
+        update.fds = reinterpret_cast<uint64>(&channel->fd);
+        if (IoUringRegister(ring_fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1) {
+            channel->fd = handle.index;
+            channel->fixed_file = true;
+        }
+    }
+
+    uring_channels_.resize(std::max<size_t>(uring_channels_.size(), handle.index + 1));
+    uring_channels_[handle.index] = std::move(channel);
+    return handle;
+}
+
+// Method to write data to a channel
+void IoUringEndpoint::Write(ChannelHandle channel, const void *buf, uint32 len) {
+    if (uring_channels_[channel.index]->shared_memory) {
+        TcpEndpoint::Write(channel, buf, len);
+        return;
+    }
+    IoUringRequest request;
+    request.send = true;
+    request.channel = channel.index;
+    request.iov.push_back({const_cast<void *>(buf), len});
+    SubmitAndWait(request);
+    total_bytes_sent_ += len;
+}
+
+// Method to write several buffers to a channel with a single gathered send
+void IoUringEndpoint::Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) {
+    if (uring_channels_[channel.index]->shared_memory) {
+        TcpEndpoint::Write(channel, buffers);
+        return;
+    }
+    IoUringRequest request;
+    request.send = true;
+    request.channel = channel.index;
+    for (const auto &b: buffers) {
+        if (b.second > 0) {
+            request.iov.push_back({const_cast<void *>(b.first), b.second});
+        }
+        total_bytes_sent_ += b.second;
+    }
+    if (!request.iov.empty()) {
+        SubmitAndWait(request);
+    }
+}
+
+// Method to take a send buffer of len bytes for AsyncWrite on a channel
+std::vector<uint8> IoUringEndpoint::AcquireBuffer(ChannelHandle channel, uint32 len) {
+    if (uring_channels_[channel.index]->shared_memory) {
+        return TcpEndpoint::AcquireBuffer(channel, len);
+    }
+    return pool_.Acquire(len);
+}
+
+// Method to asynchronously write a buffer to a channel, blocks while the bytes in flight exceed the limit
+void IoUringEndpoint::AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) {
+    IoUringChannel &uring_channel = *uring_channels_[channel.index];
+    if (uring_channel.shared_memory) {
+        TcpEndpoint::AsyncWrite(channel, std::move(buf));
+        return;
+    }
+    if (buf.empty()) {
+        return;
+    }
+
+    // only the io thread lowers the count, so the check and the increment cannot race
+    uint64 in_flight = uring_channel.in_flight_bytes.load();
+    while (in_flight != 0 && in_flight + buf.size() > max_in_flight_bytes_) {
+        uring_channel.in_flight_bytes.wait(in_flight);
+        in_flight = uring_channel.in_flight_bytes.load();
+    }
+    uring_channel.in_flight_bytes += buf.size();
+    total_bytes_sent_ += buf.size();
+
+    auto request = new IoUringRequest();
+    request->send = true;
+    request->channel = channel.index;
+    request->async = true;
+    request->owned = std::move(buf);
+    request->iov.push_back({request->owned.data(), request->owned.size()});
+    Submit(request);
+}
+
+// Method to wait until all asynchronous writes on a channel have completed
+void IoUringEndpoint::Flush(ChannelHandle channel) {
+    IoUringChannel &uring_channel = *uring_channels_[channel.index];
+    if (uring_channel.shared_memory) {
+        TcpEndpoint::Flush(channel);
+        return;
+    }
+    uint64 in_flight = uring_channel.in_flight_bytes.load();
+    while (in_flight != 0) {
+        uring_channel.in_flight_bytes.wait(in_flight);
+        in_flight = uring_channel.in_flight_bytes.load();
+    }
+}
+
+// Method to read data from a channel
+void IoUringEndpoint::Read(ChannelHandle channel, void *buf, uint32 len) {
+    if (uring_channels_[channel.index]->shared_memory) {
+        TcpEndpoint::Read(channel, buf, len);
+        return;
+    }
+    IoUringRequest request;
+    request.send = false;
+    request.channel = channel.index;
+    request.iov.push_back({buf, len});
+    SubmitAndWait(request);
+    total_bytes_received_ += len;
+}
+
+// Method to hand a request to the io thread
+void IoUringEndpoint::Submit(IoUringRequest *request) {
+    {
+        std::lock_guard<std::mutex> lock(incoming_mtx_);
+        incoming_.push_back(request);
+    }
+    // only an io thread blocked in io_uring_enter needs the eventfd
+    if (sleeping_.load()) {
+        uint64 one = 1;
+        (void) !write(wake_fd_, &one, sizeof(one));
+    }
+}
+
+// Method to hand a synchronous request to the io thread and wait for it, returns false on error
+bool IoUringEndpoint::SubmitAndWait(IoUringRequest &request) {
+    Submit(&request);
+    std::unique_lock<std::mutex> lock(request.mtx);
+    request.cv.wait(lock, [&] { return request.done; });
+    return request.result >= 0;
+}
+
+// Main loop of the io thread
+void IoUringEndpoint::Run() {
+    ArmWakeup();
+    std::vector<IoUringRequest *> batch;
+    while (!stopping_) {
+        {
+            std::lock_guard<std::mutex> lock(incoming_mtx_);
+            batch.swap(incoming_);
+        }
+        for (auto request: batch) {
+            Enqueue(request);
+        }
+        batch.clear();
+
+        // Announce the sleep, then look once more for requests submitted in between
+        sleeping_.store(true);
+        {
+            std::lock_guard<std::mutex> lock(incoming_mtx_);
+            if (!incoming_.empty()) {
+                sleeping_.store(false);
+                continue;
+            }
+        }
+
+        // Submit everything queued since the last call and wait for at least one completion
+        int ret = IoUringEnter(ring_fd_, to_submit_, 1, IORING_ENTER_GETEVENTS);
+        sleeping_.store(false);
+        if (ret >= 0) {
+            to_submit_ -= ret;
+        } else if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            std::cerr << "Error in io_uring_enter: " << std::strerror(errno) << std::endl;
+        }
+
+        uint32 head = *cq_head_;
+        while (head != LoadAcquire(cq_tail_)) {
+            const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+            uint64 user_data = cqe.user_data;
+            int res = cqe.res;
+            uint32 flags = cqe.flags;
+            // free the slot before handling, handling may issue new requests
+            StoreRelease(cq_head_, ++head);
+            HandleCompletion(user_data, res, flags);
+        }
+    }
+}
+
+// Method to queue a request on its channel, and issue it if nothing is ahead of it
+void IoUringEndpoint::Enqueue(IoUringRequest *request) {
+    if (!request->send) {
+        Issue(request);
+        return;
+    }
+    IoUringChannel &channel = *uring_channels_[request->channel];
+    channel.sends.push_back(request);
+    if (channel.sends.size() == 1) {
+        Issue(request);
+    }
+}
+
+// Method to take a free submission queue entry, submitting the queued ones if the ring is full
+io_uring_sqe *IoUringEndpoint::NextSqe() {
+    uint32 tail = *sq_tail_;
+    while (tail - LoadAcquire(sq_head_) >= sq_entries_) {
+        int ret = IoUringEnter(ring_fd_, to_submit_, 0, 0);
+        if (ret > 0) {
+            to_submit_ -= ret;
+        }
+    }
+    uint32 index = tail & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    StoreRelease(sq_tail_, tail + 1);
+    to_submit_++;
+    return sqe;
+}
+
+// Method to arm the read on the wake-up eventfd
+void IoUringEndpoint::ArmWakeup() {
+    io_uring_sqe *sqe = NextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd_;
+    sqe->addr = reinterpret_cast<uint64>(&wake_value_);
+    sqe->len = sizeof(wake_value_);
+    sqe->user_data = wakeUserData;
+}
+
+// Method to put the next transfer of a request into the submission queue
+void IoUringEndpoint::Issue(IoUringRequest *request) {
+    const IoUringChannel &channel = *uring_channels_[request->channel];
+    io_uring_sqe *sqe = NextSqe();
+    sqe->fd = channel.fd;
+    if (channel.fixed_file) {
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    sqe->user_data = reinterpret_cast<uint64>(request);
+
+    const iovec &first = request->iov[request->iov_offset];
+    if (!request->send) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = reinterpret_cast<uint64>(first.iov_base);
+        sqe->len = first.iov_len;
+        sqe->msg_flags = MSG_WAITALL;
+        return;
+    }
+
+    size_t num_iov = request->iov.size() - request->iov_offset;
+    size_t bytes = 0;
+    for (size_t i = request->iov_offset; i < request->iov.size(); i++) {
+        bytes += request->iov[i].iov_len;
+    }
+    request->zero_copy = zero_copy_ && bytes >= zeroCopyMinBytes;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if (num_iov == 1) {
+        sqe->opcode = request->zero_copy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+        sqe->addr = reinterpret_cast<uint64>(first.iov_base);
+        sqe->len = first.iov_len;
+    } else {
+        request->msg = msghdr{};
+        request->msg.msg_iov = &request->iov[request->iov_offset];
+        request->msg.msg_iovlen = num_iov;
+        sqe->opcode = request->zero_copy ? IORING_OP_SENDMSG_ZC : IORING_OP_SENDMSG;
+        sqe->addr = reinterpret_cast<uint64>(&request->msg);
+        sqe->len = 1;
+    }
+}
+
+// Method to handle one completion
+void IoUringEndpoint::HandleCompletion(uint64 user_data, int res, uint32 flags) {
+    if (user_data == wakeUserData) {
+        if (!stopping_) {
+            ArmWakeup();
+        }
+        return;
+    }
+
+    auto request = reinterpret_cast<IoUringRequest *>(user_data);
+    if (flags & IORING_CQE_F_NOTIF) {
+        // the kernel is done with a zero-copy buffer
+        request->pending_notifications--;
+        MaybeFinish(request);
+        return;
+    }
+    if (flags & IORING_CQE_F_MORE) {
+        request->pending_notifications++;
+    }
+
+    if (res < 0 && request->zero_copy && (res == -EINVAL || res == -EOPNOTSUPP)) {
+        // the kernel or the socket does not support zero copy, send normally from now on
+        std::cerr << "Zero-copy send unavailable, falling back to copying sends" << std::endl;
+        zero_copy_ = false;
+        Issue(request);
+        return;
+    }
+    if (res == -EINTR || res == -EAGAIN) {
+        Issue(request);
+        return;
+    }
+
+    if (res <= 0) {
+        std::cerr << "Error " << (request->send ? "writing to" : "reading from") << " socket: "
+                  << (res == 0 ? "connection closed" : std::strerror(-res)) << std::endl;
+        request->result = res == 0 ? -ECONNRESET : res;
+    } else {
+        // Skip the transferred bytes and continue with the rest, if any
+        size_t n = res;
+        while (n > 0 && request->iov_offset < request->iov.size()) {
+            iovec &v = request->iov[request->iov_offset];
+            if (n >= v.iov_len) {
+                n -= v.iov_len;
+                request->iov_offset++;
+            } else {
+                v.iov_base = static_cast<uint8 *>(v.iov_base) + n;
+                v.iov_len -= n;
+                n = 0;
+            }
+        }
+        if (request->iov_offset < request->iov.size()) {
+            Issue(request);
+            return;
+        }
+    }
+    request->transferred = true;
+
+    if (request->send) {
+        // the next send of the channel may go now
+        IoUringChannel &channel = *uring_channels_[request->channel];
+        channel.sends.pop_front();
+        if (!channel.sends.empty()) {
+            Issue(channel.sends.front());
+        }
+    }
+    MaybeFinish(request);
+}
+
+// Method to finish a request once its data is transferred and the kernel released its buffer
+void IoUringEndpoint::MaybeFinish(IoUringRequest *request) {
+    if (!request->transferred || request->pending_notifications > 0) {
+        return;
+    }
+
+    if (request->async) {
+        IoUringChannel &channel = *uring_channels_[request->channel];
+        uint64 bytes = request->owned.size();
+        pool_.Release(std::move(request->owned));
+        delete request;
+        channel.in_flight_bytes -= bytes;
+        channel.in_flight_bytes.notify_all();
+    } else {
+        // notify under the lock, the waiting caller owns the request and destroys it right after
+        std::lock_guard<std::mutex> lock(request->mtx);
+        request->done = true;
+        request->cv.notify_one();
+    }
+}
+
+#endif // __linux__
@@ -0,0 +1,136 @@
+#include "network/loopback_endpoint.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+const int loopbackRetryLimit = 100;
+
+// Method to register an endpoint listening on a port
+void LoopbackNetwork::Register(uint32 port, LoopbackEndpoint *endpoint) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!endpoints_.emplace(port, endpoint).second) {
+        throw std::invalid_argument("Loopback port " + std::to_string(port) + " is already in use");
+    }
+}
+
+// Method to remove the endpoint listening on a port
+void LoopbackNetwork::Unregister(uint32 port) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    endpoints_.erase(port);
+}
+
+// Method to find the endpoint listening on a port, nullptr if there is none
+LoopbackEndpoint *LoopbackNetwork::Find(uint32 port) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = endpoints_.find(port);
+    return it == endpoints_.end() ? nullptr : it->second;
+}
+
+// Method to stop the endpoint
+void LoopbackEndpoint::Stop() {
+    StopListen();
+    std::lock_guard<std::mutex> lock(mtx_);
+    resolved_channels_.clear();
+    channels_.clear();
+}
+
+// Method to connect to a remote endpoint
+void LoopbackEndpoint::Connect(const std::string &remote_name, const std::string &remote_address,
+                               const std::string &local_name) {
+    // Only the port of the address matters in-process
+    uint32 port = std::stoul(remote_address.substr(remote_address.rfind(':') + 1));
+
+    LoopbackChannel local{std::make_shared<SpscByteQueue>(network_.queue_bytes()),
+                          std::make_shared<SpscByteQueue>(network_.queue_bytes())};
+    LoopbackChannel remote{local.out, local.in};
+
+    // Retry while the remote endpoint is not listening yet, like a refused TCP connection
+    int cnt = 0;
+    LoopbackEndpoint *target = network_.Find(port);
+    while (target == nullptr || !target->Accept(local_name, remote)) {
+        if (++cnt > loopbackRetryLimit) {
+            throw std::runtime_error("Cannot connect to loopback address " + remote_address);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        target = network_.Find(port);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    channels_.insert(std::make_pair(remote_name, local));
+}
+
+// Method to add a channel opened by a remote endpoint, returns false when not listening
+bool LoopbackEndpoint::Accept(const std::string &remote_name, const LoopbackChannel &channel) {
+    if (!accept_flag_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    channels_.insert(std::make_pair(remote_name, channel));
+    return true;
+}
+
+// Method to close a connection with a remote endpoint
+void LoopbackEndpoint::CloseChannel(const std::string &remote_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    channels_.erase(remote_name);
+}
+
+// Method to find the channel of a remote endpoint by name
+LoopbackChannel &LoopbackEndpoint::FindChannel(const std::string &remote_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = channels_.find(remote_name);
+    if (it == channels_.end()) {
+        throw std::invalid_argument("No channel to remote endpoint " + remote_name);
+    }
+    return it->second;
+}
+
+// Method to write data to a remote endpoint
+void LoopbackEndpoint::Write(const std::string &remote_name, const void *buf, uint32 len) {
+    FindChannel(remote_name).out->Write(buf, len);
+    total_bytes_sent_ += len;
+}
+
+// Method to write several buffers to a remote endpoint
+void LoopbackEndpoint::Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) {
+    LoopbackChannel &channel = FindChannel(remote_name);
+    for (const auto &b: buffers) {
+        channel.out->Write(b.first, b.second);
+        total_bytes_sent_ += b.second;
+    }
+}
+
+// Method to read data from a remote endpoint
+void LoopbackEndpoint::Read(const std::string &remote_name, void *buf, uint32 len) {
+    FindChannel(remote_name).in->Read(buf, len);
+    total_bytes_received_ += len;
+}
+
+// Method to resolve the channel of a connected remote endpoint into a handle
+ChannelHandle LoopbackEndpoint::GetChannel(const std::string &remote_name) {
+    LoopbackChannel channel = FindChannel(remote_name);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (resolved_channels_.size() == resolved_channels_.capacity()) {
+        throw std::length_error("Too many resolved channels");
+    }
+    resolved_channels_.push_back(channel);
+    return ChannelHandle{static_cast<uint32>(resolved_channels_.size() - 1)};
+}
+
+// Method to get the names of all connected remote endpoints
+std::vector<std::string> LoopbackEndpoint::GetRemoteNames() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<std::string> remotes;
+    remotes.reserve(channels_.size());
+    for (const auto &channel: channels_) {
+        remotes.push_back(channel.first);
+    }
+    return remotes;
+}
+
+// Method to reset the total amount of data sent and received
+void LoopbackEndpoint::ResetCounters() {
+    total_bytes_sent_ = 0;
+    total_bytes_received_ = 0;
+}
@@ -0,0 +1,321 @@
+#include "network/mux_endpoint.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Constructor that takes the inner endpoint and the number of connections per peer address
+MuxEndpoint::MuxEndpoint(std::unique_ptr<Endpoint> inner, uint32 connections_per_peer)
+        : inner_(std::move(inner)), connections_per_peer_(std::max<uint32>(connections_per_peer, 1)) {
+    // The readers index both tables while new streams and connections are added
+    connections_.reserve(maxResolvedChannels);
+    streams_.reserve(maxResolvedChannels);
+}
+
+// Destructor that stops the endpoint unless that was done already
+MuxEndpoint::~MuxEndpoint() {
+    if (!stopped_) {
+        Stop();
+    }
+}
+
+// Method to stop the endpoint, waits until every peer has stopped its side of the connections
+void MuxEndpoint::Stop() {
+    stopped_ = true;
+    inner_->StopListen();
+    for (uint32 i = 0; i < connections_.size(); i++) {
+        WriteFrame(i, muxCloseStream, {});
+    }
+    for (auto &connection: connections_) {
+        connection->reader.join();
+    }
+    inner_->Stop();
+}
+
+// Method to open a stream to a remote endpoint
+void
+MuxEndpoint::Connect(const std::string &remote_name, const std::string &remote_address, const std::string &local_name) {
+    uint32 n, slot;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto &connections = peer_connections_[remote_address];
+        if (connections.empty()) {
+            connections.assign(connections_per_peer_, muxPendingConnection);
+        }
+        n = peer_streams_[remote_address]++;
+        slot = n % connections_per_peer_;
+    }
+
+    // The first streams to an address open its connections. The connect blocks until the remote accepts,
+    // so it runs without mtx_ and the readers keep sorting frames meanwhile
+    if (n < connections_per_peer_) {
+        // The local name of the stream is unique at the remote, and so is the connection's
+        std::string inner_name = remote_name + muxConnectionSuffix;
+        try {
+            inner_->Connect(inner_name, remote_address, local_name + muxConnectionSuffix);
+            std::lock_guard<std::mutex> lock(mtx_);
+            peer_connections_[remote_address][slot] = AddConnection(inner_name);
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                peer_connections_[remote_address][slot] = muxFailedConnection;
+            }
+            connected_cv_.notify_all();
+            throw;
+        }
+        connected_cv_.notify_all();
+    }
+
+    uint32 connection, id;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        auto &connections = peer_connections_[remote_address];
+        connected_cv_.wait(lock, [&] { return connections[slot] != muxPendingConnection; });
+        connection = connections[slot];
+        if (connection == muxFailedConnection) {
+            throw std::runtime_error("Could not connect to " + remote_address);
+        }
+        id = connections_[connection]->next_stream++;
+        AddStream(connection, id, remote_name);
+    }
+    WriteFrame(connection, id | muxOpenFlag, {{local_name.data(), local_name.size()}});
+}
+
+// Method to close a stream with a remote endpoint
+void MuxEndpoint::CloseChannel(const std::string &remote_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stream_names_.erase(remote_name);
+}
+
+// Method to write data to a remote endpoint
+void MuxEndpoint::Write(const std::string &remote_name, const void *buf, uint32 len) {
+    Write(FindStream(remote_name), buf, len);
+}
+
+// Method to write several buffers to a remote endpoint as one frame
+void MuxEndpoint::Write(const std::string &remote_name, const std::vector<ConstBuffer> &buffers) {
+    Write(FindStream(remote_name), buffers);
+}
+
+// Method to read data from a remote endpoint
+void MuxEndpoint::Read(const std::string &remote_name, void *buf, uint32 len) {
+    Read(FindStream(remote_name), buf, len);
+}
+
+// Method to resolve the stream of a connected remote endpoint into a handle
+ChannelHandle MuxEndpoint::GetChannel(const std::string &remote_name) {
+    return FindStream(remote_name);
+}
+
+// Method to write data to a channel
+void MuxEndpoint::Write(ChannelHandle channel, const void *buf, uint32 len) {
+    Stream &stream = *streams_[channel.index];
+    TakeCredit(stream, len);
+    WriteFrame(stream.connection, stream.id, {{buf, len}});
+}
+
+// Method to write several buffers to a channel as one frame
+void MuxEndpoint::Write(ChannelHandle channel, const std::vector<ConstBuffer> &buffers) {
+    Stream &stream = *streams_[channel.index];
+    uint64 len = 0;
+    for (const auto &b: buffers) {
+        len += b.second;
+    }
+    TakeCredit(stream, len);
+    WriteFrame(stream.connection, stream.id, buffers);
+}
+
+// Method to take a send buffer of len bytes for AsyncWrite on a channel
+std::vector<uint8> MuxEndpoint::AcquireBuffer(ChannelHandle channel, uint32 len) {
+    return inner_->AcquireBuffer(connections_[streams_[channel.index]->connection]->handle, len);
+}
+
+// Method to asynchronously write a buffer to a channel as one frame
+void MuxEndpoint::AsyncWrite(ChannelHandle channel, std::vector<uint8> &&buf) {
+    Stream &stream = *streams_[channel.index];
+    TakeCredit(stream, buf.size());
+    Connection &connection = *connections_[stream.connection];
+    FrameHeader header{stream.id, static_cast<uint32>(buf.size())};
+    std::vector<uint8> header_buf = inner_->AcquireBuffer(connection.handle, sizeof(header));
+    std::memcpy(header_buf.data(), &header, sizeof(header));
+
+    // The inner endpoint keeps the asynchronous writes of a connection in order
+    std::lock_guard<std::mutex> lock(connection.write_mtx);
+    inner_->AsyncWrite(connection.handle, std::move(header_buf));
+    inner_->AsyncWrite(connection.handle, std::move(buf));
+}
+
+// Method to wait until all asynchronous writes on the connection of a channel have completed
+void MuxEndpoint::Flush(ChannelHandle channel) {
+    inner_->Flush(connections_[streams_[channel.index]->connection]->handle);
+}
+
+// Method to read data from a channel
+void MuxEndpoint::Read(ChannelHandle channel, void *buf, uint32 len) {
+    Stream &stream = *streams_[channel.index];
+    auto out = static_cast<uint8 *>(buf);
+    std::unique_lock<std::mutex> lock(stream.mtx);
+    while (len > 0) {
+        stream.cv.wait(lock, [&] { return !stream.frames.empty(); });
+        auto &front = stream.frames.front();
+        size_t n = std::min<size_t>(len, front.size() - stream.offset);
+        std::memcpy(out, front.data() + stream.offset, n);
+        out += n;
+        len -= n;
+        stream.offset += n;
+        stream.consumed += n;
+        if (stream.offset == front.size()) {
+            pool_.Release(std::move(front));
+            stream.frames.pop_front();
+            stream.offset = 0;
+        }
+
+        // Return the consumed bytes as credit once they make up half the window. The credit frame may block
+        // on the connection, so it is written without the stream lock the reader of the connection takes
+        if (stream.consumed >= muxStreamWindow / 2) {
+            uint32 grant = std::min<uint64>(stream.consumed, UINT32_MAX);
+            FrameHeader header{stream.id | muxCreditFlag, grant};
+            stream.consumed -= grant;
+            lock.unlock();
+            Connection &connection = *connections_[stream.connection];
+            {
+                std::lock_guard<std::mutex> write_lock(connection.write_mtx);
+                inner_->Write(connection.handle, &header, sizeof(header));
+            }
+            lock.lock();
+        }
+    }
+}
+
+// Method to get the names of all open streams, picking up connections accepted by the inner endpoint
+std::vector<std::string> MuxEndpoint::GetRemoteNames() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &inner_name: inner_->GetRemoteNames()) {
+        if (inner_names_.find(inner_name) == inner_names_.end()) {
+            AddConnection(inner_name);
+        }
+    }
+
+    std::vector<std::string> remotes;
+    remotes.reserve(stream_names_.size());
+    for (const auto &stream: stream_names_) {
+        remotes.push_back(stream.first);
+    }
+    return remotes;
+}
+
+// Method to resolve a connection of the inner endpoint and start its reader, called with mtx_ held
+uint32 MuxEndpoint::AddConnection(const std::string &inner_name) {
+    if (connections_.size() == connections_.capacity()) {
+        throw std::length_error("Too many connections on a multiplexing endpoint");
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->handle = inner_->GetChannel(inner_name);
+    connections_.push_back(std::move(connection));
+    inner_names_.insert(inner_name);
+
+    uint32 index = connections_.size() - 1;
+    connections_[index]->reader = std::thread(&MuxEndpoint::ReadFrames, this, index);
+    return index;
+}
+
+// Method to add a stream on a connection, called with mtx_ held
+uint32 MuxEndpoint::AddStream(uint32 connection, uint32 id, const std::string &remote_name) {
+    if (streams_.size() == streams_.capacity()) {
+        throw std::length_error("Too many streams on a multiplexing endpoint");
+    }
+    auto stream = std::make_unique<Stream>();
+    stream->connection = connection;
+    stream->id = id;
+    streams_.push_back(std::move(stream));
+
+    uint32 index = streams_.size() - 1;
+    connections_[connection]->streams[id] = index;
+    stream_names_[remote_name] = index;
+    return index;
+}
+
+// Method to find the stream of a remote endpoint by name
+ChannelHandle MuxEndpoint::FindStream(const std::string &remote_name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = stream_names_.find(remote_name);
+    if (it == stream_names_.end()) {
+        throw std::invalid_argument("No channel to remote endpoint " + remote_name);
+    }
+    return ChannelHandle{it->second};
+}
+
+// Method to wait for send credit on a stream and take len bytes of it. A frame is sent as soon as any
+// credit is left, so frames larger than the window still go through
+void MuxEndpoint::TakeCredit(Stream &stream, uint64 len) {
+    std::unique_lock<std::mutex> lock(stream.mtx);
+    stream.credit_cv.wait(lock, [&] { return stream.credit > 0; });
+    stream.credit -= static_cast<long>(len);
+}
+
+// Method to write a frame on a connection
+void MuxEndpoint::WriteFrame(uint32 connection, uint32 stream, const std::vector<ConstBuffer> &buffers) {
+    FrameHeader header{stream, 0};
+    for (const auto &b: buffers) {
+        header.length += b.second;
+    }
+    std::vector<ConstBuffer> frame = {{&header, sizeof(header)}};
+    frame.insert(frame.end(), buffers.begin(), buffers.end());
+
+    Connection &c = *connections_[connection];
+    std::lock_guard<std::mutex> lock(c.write_mtx);
+    inner_->Write(c.handle, frame);
+}
+
+// Main loop of the reader of a connection, returns on the close frame of the remote
+void MuxEndpoint::ReadFrames(uint32 connection) {
+    ChannelHandle handle = connections_[connection]->handle;
+    while (true) {
+        FrameHeader header;
+        inner_->Read(handle, &header, sizeof(header));
+        if (header.stream == muxCloseStream) {
+            return;
+        }
+
+        // The remote consumed data of a stream and returns the credit
+        if (header.stream & muxCreditFlag) {
+            Stream *stream;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                stream = streams_[connections_[connection]->streams.at(header.stream & ~muxCreditFlag)].get();
+            }
+            {
+                std::lock_guard<std::mutex> lock(stream->mtx);
+                stream->credit += header.length;
+            }
+            stream->credit_cv.notify_one();
+            continue;
+        }
+
+        std::vector<uint8> payload = pool_.Acquire(header.length);
+        if (header.length > 0) {
+            inner_->Read(handle, payload.data(), header.length);
+        }
+
+        // The remote opened a stream, the payload is its name
+        if (header.stream & muxOpenFlag) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            AddStream(connection, header.stream & ~muxOpenFlag,
+                      std::string(payload.begin(), payload.end()));
+            pool_.Release(std::move(payload));
+            continue;
+        }
+
+        Stream *stream;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stream = streams_[connections_[connection]->streams.at(header.stream)].get();
+        }
+        {
+            std::lock_guard<std::mutex> lock(stream->mtx);
+            stream->frames.push_back(std::move(payload));
+        }
+        stream->cv.notify_one();
+    }
+}
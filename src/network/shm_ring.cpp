@@ -0,0 +1,212 @@
+#include "network/shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Number of polls before a blocked side goes to sleep
+const int shmSpinLimit = 256;
+
+// Function to sleep while a shared futex word still holds the expected value
+static void FutexWait(std::atomic<uint32> *word, uint32 expected) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32 *>(word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+    // no cross-process futex, poll instead
+    if (word->load() == expected) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+#endif
+}
+
+// Function to wake the sleepers on a shared futex word
+static void FutexWake(std::atomic<uint32> *word) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32 *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+// Function to throw the current errno as an exception
+static void ThrowErrno(const std::string &what, const std::string &name) {
+    throw std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+}
+
+// Constructor that takes a mapping of map_bytes bytes holding a ring of capacity bytes
+ShmRing::ShmRing(void *mapping, size_t map_bytes, uint64 capacity)
+        : mapping_(mapping), map_bytes_(map_bytes), header_(static_cast<ShmRingHeader *>(mapping)),
+          data_(static_cast<uint8 *>(mapping) + sizeof(ShmRingHeader)), capacity_(capacity), mask_(capacity - 1) {}
+
+// Unmaps the ring
+ShmRing::~ShmRing() {
+    munmap(mapping_, map_bytes_);
+}
+
+// Factory method to create a new ring of capacity bytes under a shared-memory name
+std::unique_ptr<ShmRing> ShmRing::Create(const std::string &name, size_t capacity) {
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 64));
+    size_t map_bytes = sizeof(ShmRingHeader) + capacity;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        ThrowErrno("Cannot create shared memory", name);
+    }
+    if (ftruncate(fd, map_bytes) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        ThrowErrno("Cannot size shared memory", name);
+    }
+    void *mapping = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        ThrowErrno("Cannot map shared memory", name);
+    }
+
+    auto header = new(mapping) ShmRingHeader();
+    header->capacity = capacity;
+    return std::unique_ptr<ShmRing>(new ShmRing(mapping, map_bytes, capacity));
+}
+
+// Factory method to map a ring created by another process, the name is unlinked once opened
+std::unique_ptr<ShmRing> ShmRing::Open(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        ThrowErrno("Cannot open shared memory", name);
+    }
+    // the descriptor keeps the object alive, the name is no longer needed either way
+    shm_unlink(name.c_str());
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        ThrowErrno("Cannot stat shared memory", name);
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(ShmRingHeader))) {
+        close(fd);
+        throw std::runtime_error("Shared memory " + name + " is too small for a ring");
+    }
+    size_t map_bytes = st.st_size;
+    void *mapping = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        ThrowErrno("Cannot map shared memory", name);
+    }
+
+    // The capacity is read once, the peer can change the header afterwards
+    uint64 capacity = static_cast<volatile ShmRingHeader *>(mapping)->capacity;
+    if (!std::has_single_bit(capacity) || capacity != map_bytes - sizeof(ShmRingHeader)) {
+        munmap(mapping, map_bytes);
+        throw std::runtime_error("Shared memory " + name + " does not hold a valid ring");
+    }
+    return std::unique_ptr<ShmRing>(new ShmRing(mapping, map_bytes, capacity));
+}
+
+// Method to remove the name of a ring that will not be opened
+void ShmRing::Unlink(const std::string &name) {
+    shm_unlink(name.c_str());
+}
+
+// Method to throw if the peer moved head or tail so that more than the capacity is in use
+void ShmRing::CheckUsed(uint64 used) const {
+    if (used > capacity_) {
+        throw std::runtime_error("Shared memory ring is corrupt: " + std::to_string(used) + " bytes in use of " +
+                                 std::to_string(capacity_));
+    }
+}
+
+// Method to append len bytes, blocks while the ring is full, throws on a corrupt head
+void ShmRing::Write(const void *buf, size_t len) {
+    auto src = static_cast<const uint8 *>(buf);
+    uint64 tail = header_->tail.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (len > 0) {
+        uint64 head = header_->head.load(std::memory_order_acquire);
+        CheckUsed(tail - head);
+        size_t space = capacity_ - (tail - head);
+        if (space == 0) {
+            if (++spins <= shmSpinLimit) {
+                continue;
+            }
+            // Announce the sleep before the last check, so the reader either sees the flag or we see its progress
+            header_->writer_waiting.store(1);
+            uint32 seq = header_->head_seq.load();
+            if (header_->head.load() == head) {
+                FutexWait(&header_->head_seq, seq);
+            }
+            header_->writer_waiting.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        spins = 0;
+
+        // Copy up to the end of the ring and wrap around for the rest
+        size_t n = std::min(space, len);
+        size_t offset = tail & mask_;
+        size_t first = std::min<size_t>(n, capacity_ - offset);
+        std::memcpy(data_ + offset, src, first);
+        std::memcpy(data_, src + first, n - first);
+
+        tail += n;
+        src += n;
+        len -= n;
+        header_->tail.store(tail);
+        header_->tail_seq.fetch_add(1);
+        if (header_->reader_waiting.load()) {
+            FutexWake(&header_->tail_seq);
+        }
+    }
+}
+
+// Method to take exactly len bytes, blocks until they are available, throws on a corrupt tail
+void ShmRing::Read(void *buf, size_t len) {
+    auto dst = static_cast<uint8 *>(buf);
+    uint64 head = header_->head.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (len > 0) {
+        uint64 tail = header_->tail.load(std::memory_order_acquire);
+        CheckUsed(tail - head);
+        size_t available = tail - head;
+        if (available == 0) {
+            if (++spins <= shmSpinLimit) {
+                continue;
+            }
+            header_->reader_waiting.store(1);
+            uint32 seq = header_->tail_seq.load();
+            if (header_->tail.load() == tail) {
+                FutexWait(&header_->tail_seq, seq);
+            }
+            header_->reader_waiting.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        spins = 0;
+
+        size_t n = std::min(available, len);
+        size_t offset = head & mask_;
+        size_t first = std::min<size_t>(n, capacity_ - offset);
+        std::memcpy(dst, data_ + offset, first);
+        std::memcpy(dst + first, data_, n - first);
+
+        head += n;
+        dst += n;
+        len -= n;
+        header_->head.store(head);
+        header_->head_seq.fetch_add(1);
+        if (header_->writer_waiting.load()) {
+            FutexWake(&header_->head_seq);
+        }
+    }
+}
@@ -1,18 +1,42 @@
 #include "network/tcp_endpoint.h"
 
 #include <boost/bind/bind.hpp>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 
 // Method to stop the endpoint
 void TcpEndpoint::Stop() {
     StopListen();
+    // Let queued asynchronous writes finish before the sockets are closed
+    for (auto &channel: resolved_channels_) {
+        channel->Flush();
+    }
     for (auto remote: this->GetRemoteNames()) {
         this->CloseChannel(remote);
     }
+    resolved_channels_.clear();
+    work_.reset();
     io_service_.stop();
     tg.join_all();
 };
 
+// Method to resolve the channel of a connected remote endpoint into a handle
+ChannelHandle TcpEndpoint::GetChannel(const std::string &remote_name) {
+    auto it = channels_.find(remote_name);
+    if (it == channels_.end()) {
+        throw std::invalid_argument("No channel to remote endpoint " + remote_name);
+    }
+    if (resolved_channels_.size() == resolved_channels_.capacity()) {
+        throw std::length_error("Too many resolved channels");
+    }
+    resolved_channels_.push_back(it->second);
+    return ChannelHandle{static_cast<uint32>(resolved_channels_.size() - 1)};
+}
+
 
 // Method to get the names of all connected remote endpoints
 std::vector<std::string> TcpEndpoint::GetRemoteNames() {
@@ -27,58 +51,93 @@ std::vector<std::string> TcpEndpoint::GetRemoteNames() {
     return remotes;
 };
 
-// Method to write data from the buffer to the socket
+// Method to asynchronously write a buffer to the channel, blocks while the bytes in flight exceed the limit
+void TcpChannel::AsyncWrite(std::vector<uint8> &&buf) {
+    // the shared-memory copy is as cheap as queueing
+    if (shm_out_) {
+        shm_out_->Write(buf.data(), buf.size());
+        pool_.Release(std::move(buf));
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(buffer_mtx_);
+    // a buffer larger than the limit is let through once nothing else is in flight
+    drained_.wait(lock, [&] {
+        return in_flight_bytes_ == 0 || in_flight_bytes_ + buf.size() <= max_in_flight_bytes_;
+    });
+    in_flight_bytes_ += buf.size();
+    pending_.push_back(std::move(buf));
+    if (!write_in_progress_) {
+        DoWrite();
+    }
+}
+
+// Method to wait until all asynchronous writes have completed
+void TcpChannel::Flush() {
+    std::unique_lock<std::mutex> lock(buffer_mtx_);
+    drained_.wait(lock, [&] { return in_flight_bytes_ == 0; });
+}
+
+// Method to start writing the pending buffers, called with buffer_mtx_ held
 void TcpChannel::DoWrite() {
-    // Check if there is no writing in progress
-    if (buffer_seq_.empty()) {
-        // Switch buffers
-        active_buffer_ ^= 1;
-        // Add data from the active buffer to the buffer sequence
-        for (const auto &data: buffers_[active_buffer_]) {
-            buffer_seq_.emplace_back(boost::asio::buffer(data.first, data.second));
-        }
-        // Start an asynchronous write operation
-        boost::asio::async_write(
-                socket_, buffer_seq_,
-                boost::bind(&TcpChannel::WriteHandler, shared_from_this(), boost::asio::placeholders::error,
-                            boost::asio::placeholders::bytes_transferred));
+    write_in_progress_ = true;
+    writing_.swap(pending_);
+    buffer_seq_.clear();
+    for (const auto &data: writing_) {
+        buffer_seq_.emplace_back(boost::asio::buffer(data));
     }
+    // Start an asynchronous write operation of everything queued so far
+    boost::asio::async_write(
+            socket_, buffer_seq_,
+            boost::bind(&TcpChannel::WriteHandler, shared_from_this(), boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
 }
 
 // Handler for asynchronous write operations
 void TcpChannel::WriteHandler(const boost::system::error_code &error, size_t size) {
-    std::lock_guard<std::mutex
-    > lock(buffer_mtx_);
-    // Clear the active buffer and buffer sequence
-    buffers_[active_buffer_].clear();
-    buffer_seq_.clear();
-    // Free the memory used by the data in the active buffer
-    for (const auto &data: buffers_[active_buffer_]) {
-        free(data.first);
-    }
-    // Check if there was no error
-    if (!error) {
-        // Check if there is more data to write
-        if (!buffers_[active_buffer_ ^ 1].empty()) {
-            DoWrite();
+    std::lock_guard<std::mutex> lock(buffer_mtx_);
+    // Return the written buffers to the pool
+    for (auto &data: writing_) {
+        in_flight_bytes_ -= data.size();
+        pool_.Release(std::move(data));
+    }
+    writing_.clear();
+
+    if (error) {
+        std::cerr << "Error writing to socket: " << error.message() << std::endl;
+        // Drop the queued data so that writers and Flush do not wait forever
+        for (auto &data: pending_) {
+            in_flight_bytes_ -= data.size();
         }
+        pending_.clear();
     }
+
+    // Check if there is more data to write
+    if (!pending_.empty()) {
+        DoWrite();
+    } else {
+        write_in_progress_ = false;
+    }
+    drained_.notify_all();
 }
 
 // Method to connect to a remote endpoint
 void
 TcpEndpoint::Connect(const std::string &remote_name, const std::string &remote_address, const std::string &local_name) {
+    // An shm:// address connects over TCP and then moves the data to shared memory
+    bool use_shm = remote_address.compare(0, shmScheme.size(), shmScheme) == 0;
+    std::string host_port = use_shm ? remote_address.substr(shmScheme.size()) : remote_address;
+
     // Parse the remote address and port from the input string
-    std::string addr = remote_address.substr(0, remote_address.find(':'));
-    std::string port =
-            remote_address.substr(remote_address.find(':') + 1, remote_address.length() - remote_address.find(':') - 1);
+    std::string addr = host_port.substr(0, host_port.find(':'));
+    std::string port = host_port.substr(host_port.find(':') + 1);
     // Resolve the remote address
     tcp::resolver::query query(addr, port, tcp::resolver::query::canonical_name);
     tcp::resolver::iterator endpoint_iterator = resolver_.resolve(query);
     tcp::resolver::iterator end;
 
     // Create a new TcpChannel object
-    TcpChannel::TcpChannelPointer new_connection = TcpChannel::Create(this->io_service_);
+    TcpChannel::TcpChannelPointer new_connection = TcpChannel::Create(this->io_service_, max_in_flight_bytes_);
     // Try to connect to the remote endpoint
     boost::system::error_code error = boost::asio::error::host_not_found;
     while (error && endpoint_iterator != end) {
@@ -98,14 +157,130 @@ TcpEndpoint::Connect(const std::string &remote_name, const std::string &remote_a
     // Check if there was an error
     if (error) throw boost::system::system_error(error);
 
-    const char *cstr = local_name.c_str();
-    new_connection->Write(cstr, nameSizeLimit);
+    // The name buffer holds the local name, and for shm:// the tag and the names of the two rings
+    std::vector<std::string> fields = {local_name};
+    std::string out_name, in_name;
+    if (use_shm) {
+        static std::atomic<uint32> ring_counter{0};
+        std::string prefix = "/otmpsi_" + std::to_string(getpid()) + "_" + std::to_string(ring_counter++);
+        out_name = prefix + "_a";
+        in_name = prefix + "_b";
+        fields.insert(fields.end(), {shmTransportTag, out_name, in_name});
+    }
+    char buffer[nameSizeLimit] = {0};
+    size_t pos = 0;
+    for (const auto &field: fields) {
+        if (pos + field.size() + 1 > nameSizeLimit) {
+            throw std::invalid_argument("Channel name too long: " + local_name);
+        }
+        std::memcpy(buffer + pos, field.c_str(), field.size() + 1);
+        pos += field.size() + 1;
+    }
+    std::unique_ptr<ShmRing> shm_in, shm_out;
+    if (use_shm) {
+        shm_out = ShmRing::Create(out_name, defaultShmRingBytes);
+        try {
+            shm_in = ShmRing::Create(in_name, defaultShmRingBytes);
+        } catch (...) {
+            ShmRing::Unlink(out_name);
+            throw;
+        }
+    }
+    new_connection->Write(buffer, nameSizeLimit);
+    if (use_shm) {
+        // The remote replies whether it mapped the rings, otherwise the channel stays on TCP
+        uint8 attached = 0;
+        new_connection->Read(&attached, sizeof(attached));
+        if (attached == 1) {
+            new_connection->AttachSharedMemory(std::move(shm_in), std::move(shm_out));
+        } else {
+            std::cerr << "Remote " << remote_name << " cannot attach shared memory, using TCP" << std::endl;
+            ShmRing::Unlink(out_name);
+            ShmRing::Unlink(in_name);
+        }
+    }
 
     // Add the new channel to the map of channels
     channels_.insert(std::make_pair(remote_name, new_connection));
 }
 
 
+// Function to check that a ring name has the form /otmpsi_<pid>_<n><suffix> that Connect generates, and
+// return its /otmpsi_<pid>_<n> prefix, empty if it does not
+static std::string RingPrefix(const std::string &name, const std::string &suffix) {
+    const std::string start = "/otmpsi_";
+    if (name.size() <= start.size() + suffix.size() || name.compare(0, start.size(), start) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return "";
+    }
+    std::string prefix = name.substr(0, name.size() - suffix.size());
+    std::string numbers = prefix.substr(start.size());
+    size_t separator = numbers.find('_');
+    auto digits = [](const std::string &s) {
+        return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    if (separator == std::string::npos || !digits(numbers.substr(0, separator)) ||
+        !digits(numbers.substr(separator + 1))) {
+        return "";
+    }
+    return prefix;
+}
+
+// Function to check that the remote side of a socket is on this host
+static bool IsLoopbackPeer(const boost::asio::ip::tcp::socket &socket) {
+    boost::system::error_code error;
+    boost::asio::ip::address address = socket.remote_endpoint(error).address();
+    if (error) {
+        return false;
+    }
+    if (address.is_v6() && address.to_v6().is_v4_mapped()) {
+        return boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, address.to_v6()).is_loopback();
+    }
+    return address.is_loopback();
+}
+
+// Method to attach the shared-memory rings named in the rest of a connection's name buffer, if any, and
+// reply to the connecting side whether they are attached
+void TcpEndpoint::AcceptSharedMemory(const TcpChannel::TcpChannelPointer &new_connection, const char *rest,
+                                     size_t len) {
+    std::vector<std::string> fields;
+    size_t pos = 0;
+    while (pos < len && rest[pos] != '\0' && fields.size() < 3) {
+        fields.emplace_back(rest + pos);
+        pos += fields.back().size() + 1;
+    }
+    if (fields.size() < 3 || fields[0] != shmTransportTag) {
+        return;
+    }
+
+    // the connecting side writes into the first ring and reads from the second. Only a peer on this host
+    // gets the rings, and only under names of the form Connect generates, so a peer cannot make this
+    // process open or remove other shared-memory objects. Open removes the names it opened, the
+    // connecting side removes the rest when the reply refuses
+    uint8 attached = 0;
+    std::unique_ptr<ShmRing> shm_in, shm_out;
+    std::string prefix = RingPrefix(fields[1], "_a");
+    if (!IsLoopbackPeer(new_connection->socket())) {
+        std::cerr << "Refusing shared memory from a remote host, using TCP" << std::endl;
+    } else if (prefix.empty() || RingPrefix(fields[2], "_b") != prefix) {
+        std::cerr << "Refusing shared memory under unexpected names, using TCP" << std::endl;
+    } else {
+        try {
+            shm_in = ShmRing::Open(fields[1]);
+            shm_out = ShmRing::Open(fields[2]);
+            attached = 1;
+        } catch (const std::exception &e) {
+            std::cerr << "Error attaching shared memory, using TCP: " << e.what() << std::endl;
+        }
+    }
+
+    // the reply still goes over the socket, both sides move to the rings after it
+    new_connection->Write(&attached, sizeof(attached));
+    if (attached == 1) {
+        new_connection->AttachSharedMemory(std::move(shm_in), std::move(shm_out));
+    }
+}
+
 // Method to get the total amount of data sent in a more readable form
 uint64 TcpEndpoint::GetTotalBytesSent() const {
     return total_bytes_sent_;
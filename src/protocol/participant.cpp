@@ -1,12 +1,37 @@
 #include "protocol/participant.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <numeric>
 #include <thread>
 
+#include "third_party/smhasher/MurmurHash3.h"
+#include "utils/blocking_queue.h"
+#include "utils/first_error.h"
+
 const std::string serverName = "server";
 const std::string rightNeighborName = "right";
 const std::string leftNeighborName = "left";
 
+// Number of received ring pass chunks a client buffers ahead of the one it is working on
+const size_t ringPassQueueDepth = 2;
+
+// Number of elements whose membership tests the server multiplies as one batch
+const size_t membershipTestBatchSize = 64;
+
+// Number of membership test tiles per worker at least, so small sets still spread over all workers
+const size_t membershipTestTilesPerWorker = 8;
+
 // Initialize the participant
 void Participant::Initialize() {
     if (role() == Role::client) {
@@ -15,22 +40,46 @@ void Participant::Initialize() {
         InitializeServer();
     }
 
+    ResolveChannels();
+
+    // With a persisted key the joint public key, and with it the preprocessed material, survives restarts
+    NTL::ZZ saved_public_key;
+    bool key_loaded = !options_.preprocessing_dir.empty() && LoadKey(saved_public_key);
+
     DistributedKeyGeneration();
+
+    // Another party's key changed, so the bundles encrypted under the saved joint key cannot be used
+    if (key_loaded && saved_public_key != beta_) {
+        std::cerr << "The joint public key of " << options_.local_name << " changed since the last run, "
+                  << "discarding its preprocessing store" << std::endl;
+        std::filesystem::remove(PreprocessingPath(".store"));
+    }
+
+    // beta is fixed from now on, build the fixed-base tables used by Encrypt
+    SetShortExponentBits(options_.short_exponent_bits);
+    PrecomputeFixedBases(options_.fixed_base_window_bits);
+    SetBatchIsa(options_.simd_mul_mod);
+
+    if (!options_.preprocessing_dir.empty()) {
+        SaveKey();
+        OpenPreprocessingStore();
+    }
+
     endpoint_->ResetCounters();
 }
 
 // Initialize the client participant
 void Participant::InitializeClient() {
     // Connect to the server
-    for(int i = 0; i < options_.concurrency_level; i++){
+    for(uint32 i = 0; i < options_.concurrency_level; i++){
         endpoint_->Connect(serverName + "_" + std::to_string(i), options_.server_address, options_.local_name + "_" + std::to_string(i));
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        PauseAfterConnect(i);
     }
 
     // Connect to the right neighbor
-    for(int i = 0; i < options_.concurrency_level; i++){
+    for(uint32 i = 0; i < options_.concurrency_level; i++){
         endpoint_->Connect(rightNeighborName + "_" + std::to_string(i), options_.right_neighbor_address, leftNeighborName + "_" + std::to_string(i));
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        PauseAfterConnect(i);
     }
 
 
@@ -49,9 +98,9 @@ void Participant::InitializeServer() {
         std::this_thread::sleep_for(std::chrono::seconds(2));
     }
     // Connect to the right neighbor
-    for(int i = 0; i < options_.concurrency_level; i++){
+    for(uint32 i = 0; i < options_.concurrency_level; i++){
         endpoint_->Connect(rightNeighborName + "_" + std::to_string(i), options_.right_neighbor_address, leftNeighborName + "_" + std::to_string(i));
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        PauseAfterConnect(i);
     }
 
 
@@ -63,6 +112,41 @@ void Participant::InitializeServer() {
     endpoint_->StopListen();
 }
 
+// Give the remote time to accept after the connect of channel i if it opened a socket. A multiplexing
+// endpoint opens only connections_per_peer sockets per peer, the other channels are streams on them
+void Participant::PauseAfterConnect(uint32 i) {
+    if (options_.connections_per_peer == 0 || i < options_.connections_per_peer) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+// Resolve the channel handles once all connections are established
+void Participant::ResolveChannels() {
+    auto resolve = [this](std::vector<ChannelHandle> &handles, const std::string &remote) {
+        handles.clear();
+        for (uint32 i = 0; i < options_.concurrency_level; i++) {
+            handles.push_back(endpoint_->GetChannel(remote + "_" + std::to_string(i)));
+        }
+    };
+
+    resolve(left_channels_, leftNeighborName);
+    resolve(right_channels_, rightNeighborName);
+    if (role() == Role::client) {
+        resolve(server_channels_, serverName);
+        return;
+    }
+
+    party_channels_.assign(options_.concurrency_level, std::vector<ChannelHandle>());
+    for (const auto &remote: options_.party_list) {
+        if (remote == options_.local_name) {
+            continue;
+        }
+        for (uint32 i = 0; i < options_.concurrency_level; i++) {
+            party_channels_[i].push_back(endpoint_->GetChannel(remote + "_" + std::to_string(i)));
+        }
+    }
+}
+
 // Perform distributed key generation
 void Participant::DistributedKeyGeneration() {
     if (role() == Role::server) {
@@ -90,10 +174,10 @@ void Participant::DistributedKeyGenerationServer() {
 // Perform distributed key generation for the client participant
 void Participant::DistributedKeyGenerationClient() {
     // Send the local beta value to the server
-    SendZz(serverName, beta_, 0);
+    SendZz(server_channels_[0], beta_);
 
     // Receive the final beta value from the server
-    ReceiveZz(serverName, beta_, 0);
+    ReceiveZz(server_channels_[0], beta_);
 }
 
 // Execute the protocol
@@ -101,29 +185,56 @@ std::vector<long long> Participant::Execute(bool print) {
     endpoint_->ResetCounters();
     bf_.Clear();
 
-    std::vector<Ciphertext> encrypted_bases(
-            options_.bloom_filter_size); // encrypted bases that will be passed along the ring for the purpose of voting
-    std::vector<NTL::ZZ> decrypted_bases(options_.bloom_filter_size); // decryption outputs
+    // Beyond the memory budget, the ring pass runs window by window and only the server keeps every
+    // returned base, in a file it maps
+    ContainerSizeType window = ExecutionWindow();
+    windowed_ = window < bf_.size();
+    if (windowed_ && (options_.stream_prepare || !options_.preprocessing_dir.empty())) {
+        throw std::invalid_argument("memoryBudgetMb below the Bloom filter size cannot be combined with "
+                                    "streamPrepare or preprocessingDir");
+    }
+
+    CiphertextArray encrypted_bases; // encrypted bases that will be passed along the ring for the purpose of voting
+    if (role() == Role::server && windowed_) {
+        encrypted_bases.Map(SpillDir(), options_.bloom_filter_size, options_.num_bytes_field_numbers);
+    } else if (role() == Role::server) {
+        encrypted_bases.Resize(options_.bloom_filter_size, options_.num_bytes_field_numbers);
+    }
     std::vector<std::pair<int, uint64>> result; // OTMPSI final result
-    std::vector<Ciphertext> rerand_array(
-            options_.bloom_filter_size); // probabilistic encryption of 1, used for ReRand Algorithm
+    CiphertextArray rerand_array(
+            !windowed_ ? options_.bloom_filter_size
+                       : role() == Role::server ? elements_.size()
+                                                : window,
+            options_.num_bytes_field_numbers); // probabilistic encryption of 1, used for ReRand Algorithm
     std::vector<NTL::ZZ> precomputed_table(options_.num_parties - options_.intersection_threshold + 1);
 
     auto start = std::chrono::high_resolution_clock::now();
 
+    FirstTouchCiphertexts(encrypted_bases);
+    FirstTouchCiphertexts(rerand_array);
+
 
 
 
   
 
     Prepare(encrypted_bases, rerand_array, precomputed_table);
-    RingLatency(false);
+
+    // Wait for every party to finish preparing. A streaming or windowed ring pass starts right away
+    // instead, the clients block on the first chunk while the server encrypts it
+    if (!options_.stream_prepare && !windowed_) {
+        RingLatency(false);
+    }
 
     auto preparation_done = std::chrono::high_resolution_clock::now();
 
 
 
-    RingPass(encrypted_bases, rerand_array);
+    if (windowed_) {
+        RingPassWindows(encrypted_bases, rerand_array, window);
+    } else {
+        RingPass(encrypted_bases, rerand_array, 0, bf_.size());
+    }
 
 
 
@@ -157,16 +268,78 @@ bool is_generator(const NTL::ZZ &g, const NTL::ZZ &p, const std::vector<NTL::ZZ>
     return true;
 }
 
+// With pinned workers, allocate the numbers of every ciphertext on the worker whose slice it is in
+void Participant::FirstTouchCiphertexts(std::vector<Ciphertext> &array) {
+    if (!pool_.pinned()) {
+        return;
+    }
+
+    // glibc serves every thread from its own arena, so the numbers land on the worker's node. Later
+    // writes of numbers below p fit and reuse them
+    long limbs = (NTL::NumBits(options_.p) + NTL_ZZ_NBITS - 1) / NTL_ZZ_NBITS;
+    pool_.ParallelFor(0, array.size(), [&](size_t start, size_t end, size_t) {
+        for (auto i = start; i < end; ++i) {
+            array[i].first.SetSize(limbs);
+            array[i].second.SetSize(limbs);
+        }
+    });
+}
+
+// With pinned workers, zero the slice of the arena of every worker on it
+void Participant::FirstTouchCiphertexts(CiphertextArray &array) {
+    // A file-backed arena is not meant to be resident as a whole
+    if (!pool_.pinned() || array.mapped()) {
+        return;
+    }
+
+    pool_.ParallelFor(0, array.size(), [&](size_t start, size_t end, size_t) {
+        std::memset(array.c1(start), 0, (end - start) * array.number_bytes());
+        std::memset(array.c2(start), 0, (end - start) * array.number_bytes());
+    });
+}
+
+// Hash the element set into element_positions_ unless it is already there
+void Participant::HashElements() {
+    if (element_positions_.empty() && !elements_.empty()) {
+        bf_.HashPositions(elements_, element_positions_, pool_);
+    }
+}
+
+// Encrypt a fresh pool of rerand_pool_size encryptions of 1 and install it for EncryptOne
+void Participant::PrepareRerandomizers() {
+    // Drop the previous pool first so the new one is made of real encryptions
+    SetRerandomizerPool({}, 0);
+    if (options_.rerand_pool_size == 0 || options_.rerand_subset_size == 0) {
+        return;
+    }
+
+    std::vector<Ciphertext> pool(options_.rerand_pool_size);
+    pool_.ParallelFor(0, pool.size(), [&](size_t start, size_t end, size_t) {
+        for (auto i = start; i < end; ++i) {
+            Encrypt(pool[i], NTL::ZZ(1));
+        }
+    });
+
+    SetRerandomizerPool(std::move(pool), options_.rerand_subset_size);
+}
+
 // Prepare for the protocol
-void Participant::Prepare(std::vector<Ciphertext> &encrypted_bases, std::vector<Ciphertext> &rerand_array,
+void Participant::Prepare(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
                           std::vector<NTL::ZZ> &precomputed_table) {
     // Build the bloom filter
-    for (const auto &e: elements_) {
-        bf_.Insert(e);
-    }
+    HashElements();
+    bf_.InsertPositions(element_positions_);
 
     // Invert the Bloom Filter
     bf_.Invert();
+    stream_pending_ = false;
+
+    // Material generated ahead of time by Preprocess replaces the encryptions below
+    if (TakePreprocessingBundle(encrypted_bases, rerand_array, precomputed_table)) {
+        return;
+    }
+
+    PrepareRerandomizers();
 
     // Finish the preparation
     if (role() == Role::server) {
@@ -177,207 +350,626 @@ void Participant::Prepare(std::vector<Ciphertext> &encrypted_bases, std::vector<
 }
 
 // Prepare for the protocol for the server participant
-void Participant::PrepareServer(std::vector<Ciphertext> &encrypted_bases, std::vector<Ciphertext> &rerand_array,
+void Participant::PrepareServer(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
                                 std::vector<NTL::ZZ> &precomputed_table) {
     NTL::ZZ vote_base; // vote vote_base
+    GenerateVoteBase(vote_base);
 
-
-    NTL::ZZ vote_base_power // vote vote_base power. vote vote_base = generator ^ ((p-1)/q^(t-l+1))
-            = (options_.p - 1)
-              / NTL::power(options_.q, (options_.num_parties - options_.intersection_threshold + 1));
-
-    // first make vote_base a random generator for filed Fp
-    NTL::RandomBnd(vote_base, options_.p);
-    while (!is_generator(vote_base, options_.p, options_.phi_p_prime_factor_list)) {
-        NTL::RandomBnd(vote_base, options_.p);
+    // In streaming mode RingPassServer encrypts the bases chunk by chunk as it sends them, in
+    // windowed mode RingPassWindows encrypts them window by window
+    if (options_.stream_prepare || windowed_) {
+        stream_vote_base_ = vote_base;
+        stream_pending_ = options_.stream_prepare;
+    } else {
+        pool_.ParallelFor(0, bf_.size(), [&](size_t start, size_t end, size_t) {
+            EncryptBases(encrypted_bases, vote_base, start, end);
+        });
     }
-    
-    NTL::PowerMod(vote_base, vote_base, vote_base_power, options_.p);
 
+    // Create an array of fresh encryptions of 1 to refresh the ciphertexts.
+    // For each membership test result, precompute sqrRootTrail encryptions to refresh the ciphertext
+    // in the hopes that the new ciphertext will have a square root.
+    pool_.ParallelFor(0, elements_.size(), [&](size_t start, size_t end, size_t) {
+        EncryptOnes(rerand_array, start, end);
+    });
 
+    BuildVoteTables(vote_base, precomputed_table);
+}
 
-    auto encrypt_range = [&](int start, int end) {
-        NTL::ZZ temp;
-        for (int i = start; i < end; ++i) {
-            temp = vote_base;
-            if (bf_.CheckPosition(i)) {
-                NTL::PowerMod(temp, temp, options_.q, options_.p);
-            }
-            Encrypt(encrypted_bases[i], temp);
+// Encrypt vote_base or vote_base^q into the bases in [start, end) by the inverted Bloom filter
+void Participant::EncryptBases(CiphertextArray &encrypted_bases, const NTL::ZZ &vote_base,
+                               ContainerSizeType start, ContainerSizeType end) {
+    NTL::ZZ temp;
+    Ciphertext encrypted;
+    for (auto i = start; i < end; ++i) {
+        temp = vote_base;
+        if (bf_.CheckPosition(i)) {
+            NTL::PowerMod(temp, temp, options_.q, options_.p);
         }
-    };
-
-    std::vector<std::thread> threads;
-    int total_elements = bf_.size();
-    int elements_per_thread = total_elements / options_.concurrency_level;
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-        threads.emplace_back(encrypt_range, start, end);
+        Encrypt(encrypted, temp);
+        encrypted_bases.Set(i, encrypted);
     }
+}
 
-    for (auto &th : threads) {
-        th.join();
+// Encrypt 1 into the rerandomizers in [start, end)
+void Participant::EncryptOnes(CiphertextArray &rerand_array, ContainerSizeType start, ContainerSizeType end) {
+    Ciphertext encrypted;
+    for (auto i = start; i < end; ++i) {
+        EncryptOne(encrypted);
+        rerand_array.Set(i, encrypted);
     }
-    threads.clear();
-
+}
 
-    // Create an array of fresh encryptions of 1 to refresh the ciphertexts.
-    // For each membership test result, precompute sqrRootTrail encryptions to refresh the ciphertext
-    // in the hopes that the new ciphertext will have a square root.
-    auto rerandomize_range = [&](int start, int end) {
-        for (int i = start; i < end; ++i) {
-            Encrypt(rerand_array[i], NTL::ZZ(1));
-        }
-    };
+// Draw a random vote_base of order q^(n-t+1)
+void Participant::GenerateVoteBase(NTL::ZZ &vote_base) {
+    NTL::ZZ vote_base_power // vote vote_base power. vote vote_base = generator ^ ((p-1)/q^(t-l+1))
+            = (options_.p - 1)
+              / NTL::power(options_.q, (options_.num_parties - options_.intersection_threshold + 1));
 
-    int total_rerand = elements_.size();
-    int rerand_per_thread = total_rerand / options_.concurrency_level;
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * rerand_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_rerand : (start + rerand_per_thread);
-        threads.emplace_back(rerandomize_range, start, end);
+    // first make vote_base a random generator for filed Fp
+    ChaChaStream &random = ChaChaStream::ThreadLocal();
+    random.RandomBnd(vote_base, options_.p);
+    while (!is_generator(vote_base, options_.p, options_.phi_p_prime_factor_list)) {
+        random.RandomBnd(vote_base, options_.p);
     }
 
-    for (auto &th : threads) {
-        th.join();
-    }
+    NTL::PowerMod(vote_base, vote_base, vote_base_power, options_.p);
+}
 
+// Compute the extraction tables of a vote_base: precomputed_table and dlog_table_
+void Participant::BuildVoteTables(const NTL::ZZ &vote_base, std::vector<NTL::ZZ> &precomputed_table) {
     NTL::ZZ temp = vote_base;
+    std::vector<NTL::ZZ> vote_levels; // vote_levels[l] = vote_base^(q^l)
     for (long i = options_.num_parties - options_.intersection_threshold; i >= 0; i--) {
         precomputed_table[i] = NTL::InvMod(temp, options_.p);
+        vote_levels.push_back(temp);
         NTL::PowerMod(temp, temp, options_.q, options_.p);
     }
 
-
+    // A membership test result is a product of num_hash_functions levels, one per position, where
+    // the level counts the parties that lack the position. Tabulate all such products so that
+    // ExtractCountServer can read the levels off instead of raising to the power of q repeatedly
+    dlog_table_.Build(vote_levels, options_.num_hash_functions, options_.p, options_.dlog_table_max_entries);
 }
 
 // Prepare for the protocol for the client participant
-void Participant::PrepareClient(std::vector<Ciphertext> &rerand_array) {
+void Participant::PrepareClient(CiphertextArray &rerand_array) {
     // Create an array of fresh encryptions of 1 to refresh the ciphertexts.
     // Need to refresh all the ciphertexts passed on the ring.
     // For each membership test result, precompute 10 encryptions to refresh the ciphertext
     // in the hopes that the new ciphertext will have a square root.
-     auto encrypt_range = [&](int start, int end) {
-        for (int i = start; i < end; ++i) {
-            Encrypt(rerand_array[i], NTL::ZZ(1));
-        }
-    };
-
+    // In streaming mode RingPassClient encrypts them while the chunks arrive, in windowed mode
+    // RingPassWindows encrypts them window by window
+    if (options_.stream_prepare || windowed_) {
+        stream_pending_ = options_.stream_prepare;
+        return;
+    }
+    pool_.ParallelFor(0, bf_.size(), [&](size_t start, size_t end, size_t) {
+        EncryptOnes(rerand_array, start, end);
+    });
+}
 
-    std::vector<std::thread> threads;
-    int total_elements = bf_.size(); // Assume bf_ contains the number of elements to process
-    int elements_per_thread = total_elements / options_.concurrency_level;
+// Generate preprocessing bundles for later Execute calls into the store in options.preprocessing_dir
+uint64 Participant::Preprocess(uint64 bundles) {
+    if (options_.preprocessing_dir.empty()) {
+        throw std::invalid_argument("preprocessingDir is not set for " + options_.local_name);
+    }
+    NTL::ZZ public_key;
+    if (!LoadKey(public_key)) {
+        throw std::runtime_error("No key for " + options_.local_name + " in " + options_.preprocessing_dir +
+                                 ", run the protocol once with preprocessingDir set");
+    }
 
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-        threads.emplace_back(encrypt_range, start, end);
+    // Encrypt under the joint public key of the last run instead of running key generation
+    beta_ = public_key;
+    SetShortExponentBits(options_.short_exponent_bits);
+    PrecomputeFixedBases(options_.fixed_base_window_bits);
+    SetBatchIsa(options_.simd_mul_mod);
+    OpenPreprocessingStore();
+
+    std::vector<uint8> bundle;
+    for (uint64 i = 0; i < bundles; i++) {
+        GeneratePreprocessingBundle(bundle);
+        store_->Append(bundle.data());
     }
+    return store_->Available();
+}
 
-    for (auto &th : threads) {
-        th.join();
+// Get the path of a file of this party in the preprocessing directory
+std::string Participant::PreprocessingPath(const std::string &extension) const {
+    return (std::filesystem::path(options_.preprocessing_dir) / (options_.local_name + extension)).string();
+}
+
+// Load the persisted secret key and the joint public key saved with it
+bool Participant::LoadKey(NTL::ZZ &public_key) {
+    const uint32 num_bytes = options_.num_bytes_field_numbers;
+    std::vector<uint8> buf(2 * num_bytes);
+    std::ifstream file(PreprocessingPath(".key"), std::ios::binary);
+    if (!file.read(reinterpret_cast<char *>(buf.data()), buf.size())) {
+        return false;
     }
 
+    NTL::ZZ secret_key;
+    ZZFromBytes(secret_key, buf.data(), num_bytes);
+    ZZFromBytes(public_key, buf.data() + num_bytes, num_bytes);
+    SetSecretKey(secret_key);
+    return true;
+}
+
+// Persist the secret key and the joint public key
+void Participant::SaveKey() {
+    const uint32 num_bytes = options_.num_bytes_field_numbers;
+    std::vector<uint8> buf(2 * num_bytes);
+    BytesFromZZ(buf.data(), secret_key(), num_bytes);
+    BytesFromZZ(buf.data() + num_bytes, beta_, num_bytes);
+
+    std::filesystem::create_directories(options_.preprocessing_dir);
+    std::string path = PreprocessingPath(".key");
+
+    // Only the owner may read the secret key. mkstemp creates a new file with mode 0600, so the key is
+    // never in a file anyone else could have opened, and the rename replaces an old key file as a whole
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkstemp(temp_path.data());
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create key file " + temp_path + ": " + std::strerror(errno));
+    }
+    bool written = write(fd, buf.data(), buf.size()) == static_cast<ssize_t>(buf.size()) && fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+    if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        unlink(temp_path.c_str());
+        throw std::runtime_error("Cannot write key file " + path + ": " + std::strerror(error));
+    }
+}
 
+// Open the preprocessing store for the current key and parameters
+void Participant::OpenPreprocessingStore() {
+    // The bundles are only valid for this key, group and filter size, and the server's also for n and t
+    const uint32 num_bytes = options_.num_bytes_field_numbers;
+    const uint32 fields[] = {static_cast<uint32>(role()), options_.bloom_filter_size, options_.num_parties,
+                             options_.intersection_threshold, num_bytes};
+    std::vector<uint8> params(4 * num_bytes + sizeof(fields));
+    BytesFromZZ(params.data(), options_.p, num_bytes);
+    BytesFromZZ(params.data() + num_bytes, options_.alpha, num_bytes);
+    BytesFromZZ(params.data() + 2 * num_bytes, beta_, num_bytes);
+    BytesFromZZ(params.data() + 3 * num_bytes, options_.q, num_bytes);
+    std::memcpy(params.data() + 4 * num_bytes, fields, sizeof(fields));
+
+    uint64 fingerprint[2];
+    MurmurHash3_x64_128(params.data(), static_cast<int>(params.size()), 0, fingerprint);
+    std::filesystem::create_directories(options_.preprocessing_dir);
+    store_ = PreprocessingStore::Open(PreprocessingPath(".store"), fingerprint[0], PreprocessingBundleBytes());
+}
 
+// Get the size of one preprocessing bundle
+uint64 Participant::PreprocessingBundleBytes() const {
+    const uint64 ciphertext_bytes = 2 * options_.num_bytes_field_numbers;
+    if (role() == Role::server) {
+        return options_.num_bytes_field_numbers + 2 * bf_.size() * ciphertext_bytes;
+    }
+    return bf_.size() * ciphertext_bytes;
 }
 
-// Pass the bases on the ring
-void Participant::RingPass(std::vector<Ciphertext> &encrypted_bases, const std::vector<Ciphertext> &rerand_array) {
+// Generate one preprocessing bundle
+void Participant::GeneratePreprocessingBundle(std::vector<uint8> &bundle) {
+    const uint32 num_bytes = options_.num_bytes_field_numbers;
+    const uint64 ciphertext_bytes = 2 * num_bytes;
+    bundle.resize(PreprocessingBundleBytes());
+
+    NTL::ZZ vote_base, powered_vote_base;
+    uint8 *data = bundle.data();
     if (role() == Role::server) {
-        RingPassServer(encrypted_bases);
+        // Both encryptions are stored because vote_base^q cannot be derived from the encryption of vote_base
+        // without leaving c1 a q-th power, which would reveal the filter to the first client
+        GenerateVoteBase(vote_base);
+        NTL::PowerMod(powered_vote_base, vote_base, options_.q, options_.p);
+        BytesFromZZ(data, vote_base, num_bytes);
+        data += num_bytes;
     } else {
-        RingPassClient(encrypted_bases, rerand_array);
+        PrepareRerandomizers();
     }
+
+    pool_.ParallelFor(0, bf_.size(), [&](size_t start, size_t end, size_t) {
+        Ciphertext c;
+        for (auto i = start; i < end; ++i) {
+            if (role() == Role::server) {
+                Encrypt(c, vote_base);
+                BytesFromZZ(data + i * ciphertext_bytes, c.first, num_bytes);
+                BytesFromZZ(data + i * ciphertext_bytes + num_bytes, c.second, num_bytes);
+                Encrypt(c, powered_vote_base);
+                uint8 *powered = data + (bf_.size() + i) * ciphertext_bytes;
+                BytesFromZZ(powered, c.first, num_bytes);
+                BytesFromZZ(powered + num_bytes, c.second, num_bytes);
+            } else {
+                EncryptOne(c);
+                BytesFromZZ(data + i * ciphertext_bytes, c.first, num_bytes);
+                BytesFromZZ(data + i * ciphertext_bytes + num_bytes, c.second, num_bytes);
+            }
+        }
+    });
 }
 
-// Pass the bases on the ring for the server participant
-void Participant::RingPassServer(std::vector<Ciphertext> &encrypted_bases) {
-    auto range = [&](int start, int end, int thread) {
-        for (int i = start; i < end; ++i) {
-            SendCiphertext(rightNeighborName, encrypted_bases[i], thread);
+// Take a fresh bundle from the preprocessing store in place of Prepare's encryptions
+bool Participant::TakePreprocessingBundle(CiphertextArray &encrypted_bases,
+                                          CiphertextArray &rerand_array,
+                                          std::vector<NTL::ZZ> &precomputed_table) {
+    if (!store_) {
+        return false;
+    }
+    std::vector<uint8> bundle(PreprocessingBundleBytes());
+    if (!store_->Take(bundle.data())) {
+        return false;
+    }
+
+    const uint32 num_bytes = options_.num_bytes_field_numbers;
+    const uint64 ciphertext_bytes = 2 * num_bytes;
+    const uint8 *data = bundle.data();
+    NTL::ZZ vote_base;
+    if (role() == Role::server) {
+        ZZFromBytes(vote_base, data, num_bytes);
+        data += num_bytes;
+    }
+
+    // The server picks the encryption of vote_base or vote_base^q by its filter. Its rerand_array is
+    // not read after Prepare, so it is left empty
+    pool_.ParallelFor(0, bf_.size(), [&](size_t start, size_t end, size_t) {
+        for (auto i = start; i < end; ++i) {
+            if (role() == Role::server) {
+                const uint8 *src = data + (bf_.CheckPosition(i) ? bf_.size() + i : i) * ciphertext_bytes;
+                encrypted_bases.SetBytes(i, src, src + num_bytes, num_bytes);
+            } else {
+                const uint8 *src = data + i * ciphertext_bytes;
+                rerand_array.SetBytes(i, src, src + num_bytes, num_bytes);
+            }
         }
+    });
+
+    if (role() == Role::server) {
+        BuildVoteTables(vote_base, precomputed_table);
+    }
+    return true;
+}
+
+// Get the number of Bloom filter positions that fit in options.memory_budget_mb
+ContainerSizeType Participant::ExecutionWindow() const {
+    if (options_.memory_budget_mb == 0) {
+        return bf_.size();
+    }
+
+    // Every party has to get the same windows, so a position is priced the same on the server and the
+    // clients: a ciphertext in each of two arenas
+    uint64 value_bytes = (options_.num_bytes_field_numbers + sizeof(uint64) - 1) / sizeof(uint64) * sizeof(uint64);
+    uint64 position_bytes = 4 * value_bytes;
+    uint64 window = (options_.memory_budget_mb << 20) / position_bytes;
+
+    // A window is whole ring pass chunks on every channel
+    uint64 granule = static_cast<uint64>(std::max<uint32>(options_.ring_pass_chunk_size, 1)) *
+                     options_.concurrency_level;
+    window = std::max(granule, window / granule * granule);
+    return std::min<uint64>(window, bf_.size());
+}
 
-        for (int i = start; i < end; ++i) {
-            ReceiveCiphertext(leftNeighborName, encrypted_bases[i], thread);
+// Get the directory of the server's file of returned ciphertexts
+std::string Participant::SpillDir() const {
+    return options_.spill_dir.empty() ? std::filesystem::temp_directory_path().string() : options_.spill_dir;
+}
+
+// Encrypt and pass the ring pass inputs window by window
+void Participant::RingPassWindows(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
+                                  ContainerSizeType window) {
+    for (ContainerSizeType begin = 0; begin < bf_.size(); begin += window) {
+        ContainerSizeType end = std::min<ContainerSizeType>(begin + window, bf_.size());
+        if (role() == Role::server) {
+            pool_.ParallelFor(begin, end, [&](size_t start, size_t stop, size_t) {
+                EncryptBases(encrypted_bases, stream_vote_base_, start, stop);
+            });
+        } else {
+            pool_.ParallelFor(0, end - begin, [&](size_t start, size_t stop, size_t) {
+                EncryptOnes(rerand_array, start, stop);
+            });
         }
+
+        RingPass(encrypted_bases, rerand_array, begin, end);
+
+        // The returned bases of the window leave memory for the file, the membership tests read them back
+        encrypted_bases.Release(begin, end);
+    }
+}
+
+// Pass the bases in [begin, end) on the ring
+void Participant::RingPass(CiphertextArray &encrypted_bases, CiphertextArray &rerand_array,
+                           ContainerSizeType begin, ContainerSizeType end) {
+    if (role() == Role::server) {
+        RingPassServer(encrypted_bases, begin, end);
+    } else {
+        RingPassClient(rerand_array, begin, end);
+    }
+}
+
+// Pass the bases on the ring for the server participant
+void Participant::RingPassServer(CiphertextArray &encrypted_bases, ContainerSizeType begin, ContainerSizeType end) {
+    ContainerSizeType chunk_size = std::max<ContainerSizeType>(options_.ring_pass_chunk_size, 1);
+    StreamedChunks streamed;
+    FirstError errors;
+
+    auto range = [&](ContainerSizeType start, ContainerSizeType end, int thread) {
+        // Receive concurrently with sending, so the last client can hand back chunks as soon as
+        // they are done. A chunk only comes back after it was packed and sent, so the receiver
+        // never overwrites ciphertexts the sender still has to read
+        std::thread receiver([&, start, end, thread] {
+            errors.Run([&] {
+                for (auto i = start; i < end;) {
+                    i += ReceiveCiphertextChunk(left_channels_[thread], encrypted_bases, i,
+                                                std::min(chunk_size, end - i));
+                }
+            });
+        });
+
+        errors.Run([&] {
+            size_t chunk = 0;
+            for (auto i = start; i < end; i += chunk_size) {
+                if (stream_pending_) {
+                    WaitStreamed(streamed, thread, chunk++);
+                }
+                uint32 count = std::min(chunk_size, end - i);
+                SendCiphertextChunk(right_channels_[thread], encrypted_bases, i, count);
+            }
+            endpoint_->Flush(right_channels_[thread]);
+        });
+        receiver.join();
     };
 
+    // The channel threads wait on the chunk layout, so it is in place before they start
+    if (stream_pending_) {
+        LayoutStreamed(streamed);
+    }
+
     std::vector<std::thread> threads;
-    int total_elements = encrypted_bases.size();
-    int elements_per_thread = total_elements / options_.concurrency_level;
+    ContainerSizeType total_elements = end - begin;
+    ContainerSizeType elements_per_thread = total_elements / options_.concurrency_level;
 
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-        threads.emplace_back(range, start, end, i);
+    for (uint32 i = 0; i < options_.concurrency_level; ++i) {
+        ContainerSizeType start = begin + i * elements_per_thread;
+        ContainerSizeType stop = (i == options_.concurrency_level - 1) ? end : (start + elements_per_thread);
+        threads.emplace_back(range, start, stop, i);
+    }
+
+    // The channel threads send every chunk as soon as the workers have encrypted it
+    if (stream_pending_) {
+        EncryptStreamed(streamed, [&](ContainerSizeType start, ContainerSizeType end) {
+            EncryptBases(encrypted_bases, stream_vote_base_, start, end);
+        });
     }
 
     for (auto &th : threads) {
         th.join();
     }
+    errors.Rethrow();
 }
 
 // Pass the bases on the ring for the client participant
 void
-Participant::RingPassClient(std::vector<Ciphertext> &encrypted_bases, const std::vector<Ciphertext> &rerand_array) {
-    auto range = [&](int start, int end, int thread) {
-        Ciphertext temp;
-        for (auto i = start; i < end; i++) {
-            // receive from left neighbor
-            ReceiveCiphertext(leftNeighborName, temp, thread);
-
-            // raise to Power of q if it is a 1 in node's rbf
-            if (bf_.CheckPosition(i)) {
-                Power(temp, temp, options_.q);
-            }
+Participant::RingPassClient(CiphertextArray &rerand_array, ContainerSizeType begin, ContainerSizeType end) {
+    ContainerSizeType chunk_size = std::max<ContainerSizeType>(options_.ring_pass_chunk_size, 1);
+    StreamedChunks streamed;
+    FirstError errors;
+
+    auto range = [&](ContainerSizeType start, ContainerSizeType end, int thread) {
+        // A reader thread keeps the next chunks in flight while this thread works on the current one
+        BlockingQueue<CiphertextArray> inbox(ringPassQueueDepth);
+        std::thread reader([&, start, end, thread] {
+            errors.Run([&] {
+                for (auto i = start; i < end;) {
+                    CiphertextArray chunk;
+                    ReceiveCiphertextChunk(left_channels_[thread], chunk, std::min(chunk_size, end - i));
+                    i += chunk.size();
+                    inbox.Push(std::move(chunk));
+                }
+            });
+            // Chunks are never empty, an empty one tells this channel's thread that no more chunks come
+            inbox.Push(CiphertextArray());
+        });
+
+        bool ok = errors.Run([&] {
+            std::vector<size_t> slots, rerand_slots, raised;
+            size_t chunk_number = 0;
+            for (auto i = start; i < end;) {
+                CiphertextArray chunk = inbox.Pop();
+                uint32 count = chunk.size();
+                if (count == 0) {
+                    return;
+                }
+                if (stream_pending_) {
+                    WaitStreamed(streamed, thread, chunk_number++);
+                }
 
-            // ReRand c
-            Mul(temp, temp, rerand_array[i]);
+                slots.resize(count);
+                rerand_slots.resize(count);
+                raised.clear();
+                for (uint32 j = 0; j < count; j++) {
+                    slots[j] = j;
+                    rerand_slots[j] = i - begin + j;
+                    if (bf_.CheckPosition(i + j)) {
+                        raised.push_back(j);
+                    }
+                }
 
-            // send to right neighbor
-            if(options_.id != options_.num_parties-1){
-                SendCiphertext(rightNeighborName, temp, thread);
-            } else {
-                encrypted_bases[i] = temp;
-            }
-        }
+                // raise the positions that are a 1 in node's rbf to the power of q, then ReRand the whole chunk.
+                // Both run in place on the limbs of the chunk as it was received and is sent on
+                PowerBatch(chunk, raised.data(), options_.q, raised.size());
+                MulBatch(chunk, slots.data(), rerand_array, rerand_slots.data(), count);
 
-        if(options_.id == options_.num_parties-1){
-            for (auto i = start; i < end; i++) {
-                // if head, send ciphertexts to right neighbor to start
-                SendCiphertext(rightNeighborName, encrypted_bases[i], thread);
+                // send to right neighbor, the last client sends back to the server
+                SendCiphertextChunk(right_channels_[thread], chunk, 0, count);
+                i += count;
             }
+            endpoint_->Flush(right_channels_[thread]);
+        });
+        // After an error here, take what the reader still delivers so it never blocks on a full inbox
+        while (!ok && inbox.Pop().size() > 0) {
         }
+        reader.join();
     };
 
+    // The channel threads wait on the chunk layout, so it is in place before they start
+    if (stream_pending_) {
+        LayoutStreamed(streamed);
+    }
+
     std::vector<std::thread> threads;
-    int total_elements = encrypted_bases.size();
-    int elements_per_thread = total_elements / options_.concurrency_level;
+    ContainerSizeType total_elements = end - begin;
+    ContainerSizeType elements_per_thread = total_elements / options_.concurrency_level;
 
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-        threads.emplace_back(range, start, end, i);
+    for (uint32 i = 0; i < options_.concurrency_level; ++i) {
+        ContainerSizeType start = begin + i * elements_per_thread;
+        ContainerSizeType stop = (i == options_.concurrency_level - 1) ? end : (start + elements_per_thread);
+        threads.emplace_back(range, start, stop, i);
+    }
+
+    // The rerandomizers are encrypted in the order the chunks come in, starting before the first one arrives
+    if (stream_pending_) {
+        EncryptStreamed(streamed, [&](ContainerSizeType start, ContainerSizeType end) {
+            EncryptOnes(rerand_array, start, end);
+        });
     }
 
     for (auto &th : threads) {
         th.join();
     }
+    errors.Rethrow();
+}
+
+// Lay out the ring pass chunks of every channel and mark them all pending
+void Participant::LayoutStreamed(StreamedChunks &chunks) {
+    // Lay out the chunks the way the ring pass sends them: an equal slice per channel, split into
+    // ring_pass_chunk_size pieces, and order them by their place within the slice
+    ContainerSizeType chunk_size = std::max<ContainerSizeType>(options_.ring_pass_chunk_size, 1);
+    ContainerSizeType total_elements = bf_.size();
+    ContainerSizeType elements_per_thread = total_elements / options_.concurrency_level;
+    std::lock_guard<std::mutex> lock(chunks.mtx);
+    chunks.slices.clear();
+    size_t max_chunks = 0;
+    for (uint32 i = 0; i < options_.concurrency_level; ++i) {
+        ContainerSizeType start = i * elements_per_thread;
+        ContainerSizeType end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
+        chunks.slices.emplace_back(start, end);
+        max_chunks = std::max<size_t>(max_chunks, (end - start + chunk_size - 1) / chunk_size);
+    }
+
+    chunks.order.clear();
+    for (size_t c = 0; c < max_chunks; c++) {
+        for (uint32 t = 0; t < chunks.slices.size(); t++) {
+            if (chunks.slices[t].first + c * chunk_size < chunks.slices[t].second) {
+                chunks.order.emplace_back(t, c);
+            }
+        }
+    }
+    chunks.done.assign(chunks.slices.size(), std::vector<uint8>());
+    for (uint32 t = 0; t < chunks.slices.size(); t++) {
+        chunks.done[t].assign((chunks.slices[t].second - chunks.slices[t].first + chunk_size - 1) / chunk_size, 0);
+    }
+}
+
+// Run encrypt on the workers over the laid out ring pass chunks, the first chunks of every channel first
+void Participant::EncryptStreamed(StreamedChunks &chunks,
+                                  const std::function<void(ContainerSizeType, ContainerSizeType)> &encrypt) {
+    ContainerSizeType chunk_size = std::max<ContainerSizeType>(options_.ring_pass_chunk_size, 1);
+    const auto &slices = chunks.slices;
+    const auto &order = chunks.order;
+
+    // Every call takes the next chunks in order instead of the range it was handed, so the workers
+    // finish the chunks in about the order the channels wait for them
+    std::atomic<size_t> next{0};
+    pool_.ParallelFor(0, order.size(), [&](size_t start, size_t end, size_t) {
+        for (auto n = start; n < end; n++) {
+            auto [t, c] = order[next++];
+            ContainerSizeType chunk_start = slices[t].first + c * chunk_size;
+            encrypt(chunk_start, std::min(slices[t].second, chunk_start + chunk_size));
+            {
+                std::lock_guard<std::mutex> lock(chunks.mtx);
+                chunks.done[t][c] = 1;
+            }
+            chunks.cv.notify_all();
+        }
+    }, 1);
+}
+
+// Wait until the workers have encrypted a chunk of a channel
+void Participant::WaitStreamed(StreamedChunks &chunks, int channel, size_t chunk) {
+    std::unique_lock<std::mutex> lock(chunks.mtx);
+    chunks.cv.wait(lock, [&] { return chunk < chunks.done[channel].size() && chunks.done[channel][chunk]; });
+}
+
+// Function to get the bytes of each span of a chunk of count ciphertexts, in 64 bits. Throws if the framed
+// message is beyond the uint32 length the endpoints take
+static uint64 ChunkSpanBytes(uint32 count, uint32 number_bytes) {
+    uint64 span_bytes = static_cast<uint64>(count) * number_bytes;
+    if (sizeof(count) + 2 * span_bytes > UINT32_MAX) {
+        throw std::length_error("Ciphertext chunk of " + std::to_string(count) + " exceeds the message size limit, "
+                                "lower ringPassChunkSize");
+    }
+    return span_bytes;
+}
+
+// Queue count ciphertexts of an array from start on for a remote participant as one framed message
+void Participant::SendCiphertextChunk(ChannelHandle channel, const CiphertextArray &array, ContainerSizeType start,
+                                      uint32 count) {
+    // The values are stored as they go on the wire, so the two spans are copied as they are
+    uint64 span_bytes = ChunkSpanBytes(count, array.number_bytes());
+    std::vector<uint8> buf = endpoint_->AcquireBuffer(channel, sizeof(count) + 2 * span_bytes);
+    std::memcpy(buf.data(), &count, sizeof(count));
+    std::memcpy(buf.data() + sizeof(count), array.c1(start), span_bytes);
+    std::memcpy(buf.data() + sizeof(count) + span_bytes, array.c2(start), span_bytes);
+
+    // the caller goes on computing while the chunk is written
+    endpoint_->AsyncWrite(channel, std::move(buf));
+}
+
+// Function to throw unless the count of a received chunk is between 1 and max_count
+static void CheckChunkCount(uint32 count, uint32 max_count) {
+    if (count == 0 || count > max_count) {
+        throw std::runtime_error("Received a ciphertext chunk of " + std::to_string(count) + ", expected 1 to " +
+                                 std::to_string(max_count));
+    }
+}
+
+// Receive a framed message of 1 to max_count ciphertexts from a remote participant straight into an array
+// from start on
+uint32 Participant::ReceiveCiphertextChunk(ChannelHandle channel, CiphertextArray &array, ContainerSizeType start,
+                                           uint32 max_count) {
+    uint32 count;
+    endpoint_->Read(channel, &count, sizeof(count));
+    CheckChunkCount(count, std::min<size_t>(max_count, array.size() - start));
+    uint64 span_bytes = ChunkSpanBytes(count, array.number_bytes());
+    endpoint_->Read(channel, array.c1(start), span_bytes);
+    endpoint_->Read(channel, array.c2(start), span_bytes);
+    return count;
+}
+
+// Receive a framed message of 1 to max_count ciphertexts from a remote participant into chunk, resized to
+// the count
+void Participant::ReceiveCiphertextChunk(ChannelHandle channel, CiphertextArray &chunk, uint32 max_count) {
+    uint32 count;
+    endpoint_->Read(channel, &count, sizeof(count));
+    CheckChunkCount(count, max_count);
+    chunk.Resize(count, options_.num_bytes_field_numbers);
+    uint64 span_bytes = ChunkSpanBytes(count, chunk.number_bytes());
+    endpoint_->Read(channel, chunk.c1(0), span_bytes);
+    endpoint_->Read(channel, chunk.c2(0), span_bytes);
 }
 
 
 // Find the intersection of the sets
 void Participant::FindIntersection(std::vector<std::pair<int, uint64>> &intersection,
-                                   const std::vector<Ciphertext> &encrypted_bases,
-                                   const std::vector<Ciphertext> &rerand_array,
+                                   const CiphertextArray &encrypted_bases,
+                                   const CiphertextArray &rerand_array,
                                    const std::vector<NTL::ZZ> &precomputed_table) {
     
     std::vector<Ciphertext> encrypted_membership_test_results(elements_.size());
 
     // Server does the membership tests
     if (role() == Role::server) {
+        FirstTouchCiphertexts(encrypted_membership_test_results);
         MembershipTestServer(encrypted_membership_test_results, encrypted_bases);
     }
 
@@ -385,23 +977,21 @@ void Participant::FindIntersection(std::vector<std::pair<int, uint64>> &intersec
 
     // Mutual decryption
     std::vector<NTL::ZZ> membership_test_results(elements_.size());
-    auto range = [&](int start, int end, int thread) {
-        for (auto i = start; i < end; i++) {
-            if (role() == Role::server) {
-                MutualDecryptServer(membership_test_results[i], encrypted_membership_test_results[i], thread);
-            } else {
-                MutualDecryptClient(thread);
-            }
+    auto range = [&](ContainerSizeType start, ContainerSizeType end, int thread) {
+        if (role() == Role::server) {
+            MutualDecryptServer(membership_test_results, encrypted_membership_test_results, start, end, thread);
+        } else {
+            MutualDecryptClient(thread);
         }
     };
 
     std::vector<std::thread> threads;
-    int total_elements = elements_.size();
-    int elements_per_thread = total_elements / options_.concurrency_level;
+    ContainerSizeType total_elements = elements_.size();
+    ContainerSizeType elements_per_thread = total_elements / options_.concurrency_level;
 
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
+    for (uint32 i = 0; i < options_.concurrency_level; ++i) {
+        ContainerSizeType start = i * elements_per_thread;
+        ContainerSizeType end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
         threads.emplace_back(range, start, end, i);
     }
 
@@ -420,29 +1010,15 @@ void Participant::FindIntersection(std::vector<std::pair<int, uint64>> &intersec
 
 
    if (role() == Role::server) {
-        std::vector<std::thread> threads;
-        std::vector<std::vector<std::pair<int, uint64>>> local_intersections(options_.concurrency_level);
-        int total_elements = elements_.size();
-        int elements_per_thread = total_elements / options_.concurrency_level;
-
-        auto range = [&](int start, int end, int thread_id) {
-            for (int i = start; i < end; i++) {
+        std::vector<std::vector<std::pair<int, uint64>>> local_intersections(pool_.size());
+        pool_.ParallelFor(0, elements_.size(), [&](size_t start, size_t end, size_t worker) {
+            for (auto i = start; i < end; i++) {
                 auto cnt = ExtractCountServer(membership_test_results[i], precomputed_table);
                 if (cnt != 0) {
-                    local_intersections[thread_id].emplace_back(cnt, elements_[i]);
+                    local_intersections[worker].emplace_back(cnt, elements_[i]);
                 }
             }
-        };
-
-        for (int i = 0; i < options_.concurrency_level; ++i) {
-            int start = i * elements_per_thread;
-            int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-            threads.emplace_back(range, start, end, i);
-        }
-
-        for (auto &th : threads) {
-            th.join();
-        }
+        });
 
         // Merge local intersections into the main intersection vector
         for (auto &local : local_intersections) {
@@ -455,67 +1031,166 @@ void Participant::FindIntersection(std::vector<std::pair<int, uint64>> &intersec
 
 // Perform membership tests for the server participant
 void Participant::MembershipTestServer(std::vector<Ciphertext> &encrypted_membership_test_results,
-                                       const std::vector<Ciphertext> &encrypted_bases) {
-    auto range = [&](int start, int end) {
-        Ciphertext test_result;
-        for (auto i = start; i < end; i++) {
-            auto positions = GetHashPositions(elements_[i], options_.bloom_filter_size, options_.murmurhash_seeds);
-            test_result = encrypted_bases[positions[0]];
-            for (int j = 1; j < positions.size(); j++) {
-                Mul(test_result, test_result, encrypted_bases[positions[j]]);
+                                       const CiphertextArray &encrypted_bases) {
+    const size_t k = bf_.num_hashes();
+    // Tiles are the unit of work, so they shrink until every worker gets several of them
+    const size_t tiles_wanted = pool_.size() * membershipTestTilesPerWorker;
+    const size_t tile = std::min<size_t>(options_.membership_test_tile_size,
+                                         (elements_.size() + tiles_wanted - 1) / tiles_wanted);
+    std::vector<MissCounters::Counts> misses(pool_.size(), MissCounters::Counts{});
+
+    // Input order: the j-th bases of a batch of elements are multiplied into their products at once. The
+    // products stay limbs in a scratch arena and become NTL numbers once they are complete
+    auto input_order = [&](size_t start, size_t end, size_t worker) {
+        MissCounters counters;
+        CiphertextArray products(membershipTestBatchSize, encrypted_bases.number_bytes());
+        std::vector<size_t> slots(membershipTestBatchSize), bases(membershipTestBatchSize);
+        std::iota(slots.begin(), slots.end(), 0);
+        for (auto b = start; b < end; b += membershipTestBatchSize) {
+            size_t count = std::min(membershipTestBatchSize, end - b);
+            for (size_t i = 0; i < count; i++) {
+                products.Copy(i, encrypted_bases, element_positions_[(b + i) * k]);
+            }
+            for (size_t j = 1; j < k; j++) {
+                for (size_t i = 0; i < count; i++) {
+                    bases[i] = element_positions_[(b + i) * k + j];
+                }
+                MulBatch(products, slots.data(), encrypted_bases, bases.data(), count);
+            }
+            for (size_t i = 0; i < count; i++) {
+                products.Get(i, encrypted_membership_test_results[b + i]);
             }
-            encrypted_membership_test_results[i] = test_result;
         }
+        misses[worker] += counters.Read();
     };
 
+    // Position order: the bases of a tile of elements are read by ascending position, so consecutive reads
+    // share pages and cache lines instead of landing anywhere in the arena. Every element multiplies its
+    // bases into its product as they come by, the products are the same as in input order
+    auto position_order = [&](size_t first_tile, size_t last_tile, size_t worker) {
+        MissCounters counters;
+        std::vector<std::pair<ContainerSizeType, uint32>> slots; // (position, element within the tile)
+        std::vector<uint8> started(tile);
+        std::vector<uint64> batch_of(tile, 0);
+        CiphertextArray products(tile, encrypted_bases.number_bytes());
+        std::vector<size_t> elements(membershipTestBatchSize), bases(membershipTestBatchSize);
+
+        // A batch holds at most one product of each element, so its products do not depend on each other
+        uint64 batch = 1;
+        size_t pending = 0;
+        auto flush = [&] {
+            if (pending > 0) {
+                MulBatch(products, elements.data(), encrypted_bases, bases.data(), pending);
+                pending = 0;
+            }
+            batch++;
+        };
 
-    std::vector<std::thread> threads;
-    int total_elements = elements_.size();
-    int elements_per_thread = total_elements / options_.concurrency_level;
+        for (size_t t = first_tile; t < last_tile; t++) {
+            size_t begin = t * tile;
+            size_t count = std::min(tile, elements_.size() - begin);
+            slots.clear();
+            for (size_t i = 0; i < count; i++) {
+                for (size_t j = 0; j < k; j++) {
+                    slots.emplace_back(element_positions_[(begin + i) * k + j], i);
+                }
+            }
+            std::sort(slots.begin(), slots.end());
+            std::fill(started.begin(), started.end(), 0);
+
+            // The first base of an element starts its product, the others are multiplied into it
+            for (const auto &[position, i]: slots) {
+                if (!started[i]) {
+                    products.Copy(i, encrypted_bases, position);
+                    started[i] = 1;
+                    continue;
+                }
+                if (batch_of[i] == batch) {
+                    flush();
+                }
+                elements[pending] = i;
+                bases[pending++] = position;
+                batch_of[i] = batch;
+                if (pending == membershipTestBatchSize) {
+                    flush();
+                }
+            }
+            flush();
+            for (size_t i = 0; i < count; i++) {
+                products.Get(i, encrypted_membership_test_results[begin + i]);
+            }
+        }
+        misses[worker] += counters.Read();
+    };
 
-    for (int i = 0; i < options_.concurrency_level; ++i) {
-        int start = i * elements_per_thread;
-        int end = (i == options_.concurrency_level - 1) ? total_elements : (start + elements_per_thread);
-        threads.emplace_back(range, start, end);
+    if (options_.membership_test_tile_size == 0 || tile == 0) {
+        pool_.ParallelFor(0, elements_.size(), input_order);
+    } else {
+        pool_.ParallelFor(0, (elements_.size() + tile - 1) / tile, position_order);
     }
-
-    for (auto &th : threads) {
-        th.join();
+    for (const auto &m: misses) {
+        membership_test_misses_ += m;
     }
 }
 
 
-// Perform mutual decryption for the server participant
-void Participant::MutualDecryptServer(NTL::ZZ &result, const Ciphertext &c, int channel) {
-    NTL::ZZ temp;
-    // broadcast the first part of the ciphertext
-    BroadcastZz(c.first, channel);
-
-
-    // prepare server's own decryption share
-    std::vector<NTL::ZZ> shares;
-    shares.reserve(options_.party_list.size());
-    PartialDecrypt(temp, c.first);
-    shares.push_back(std::move(temp));
-
-    // collect decryption shares from all other parties
-    CollectZz(shares, channel);
+// Perform mutual decryption of the ciphertexts in [start, end) for the server participant
+void Participant::MutualDecryptServer(std::vector<NTL::ZZ> &results, const std::vector<Ciphertext> &c,
+                                      ContainerSizeType start, ContainerSizeType end, int channel) {
+    // broadcast the first parts of the ciphertexts in one message
+    std::vector<NTL::ZZ> c1_array;
+    c1_array.reserve(end - start);
+    for (auto i = start; i < end; i++) {
+        c1_array.push_back(c[i].first);
+    }
+    BroadcastZzArray(c1_array, channel);
+
+    // collect the decryption shares of all other parties, one message per party
+    std::vector<std::vector<NTL::ZZ>> remote_shares;
+    CollectZzArray(remote_shares, channel, end - start);
+    for (const auto &s: remote_shares) {
+        if (s.size() != end - start) {
+            throw std::runtime_error("Expected " + std::to_string(end - start) + " decryption shares, received " +
+                                     std::to_string(s.size()));
+        }
+    }
 
-    // fully decrypt using the decrpytion shares
-    FullyDecrypt(result, shares, c.second);
+    // fully decrypt using the server's own decryption share and the collected ones
+    std::vector<NTL::ZZ> shares(remote_shares.size() + 1);
+    for (auto i = start; i < end; i++) {
+        PartialDecrypt(shares[0], c1_array[i - start]);
+        for (size_t j = 0; j < remote_shares.size(); j++) {
+            shares[j + 1] = std::move(remote_shares[j][i - start]);
+        }
+        FullyDecrypt(results[i], shares, c[i].second);
+    }
 }
 
-// Perform mutual decryption for the client participant
+// Perform mutual decryption of one batch for the client participant
 void Participant::MutualDecryptClient(int channel) {
-    NTL::ZZ d, temp;
-    ReceiveZz(serverName, temp, channel);
-    PartialDecrypt(d, temp);
-    SendZz(serverName, d, channel);
+    // The server tests at most as many elements as the Bloom filter has positions
+    std::vector<NTL::ZZ> zz_array;
+    ReceiveZzArray(server_channels_[channel], zz_array, options_.bloom_filter_size);
+    for (auto &z: zz_array) {
+        PartialDecrypt(z, z);
+    }
+    SendZzArray(server_channels_[channel], zz_array);
 }
 
 // Extract the hidden count for server participant
 uint32 Participant::ExtractCountServer(NTL::ZZ &membership_test_result, const std::vector<NTL::ZZ> &precomputed_table) {
     uint32 cnt;
+    DlogTable::Entry entry;
+    if (dlog_table_.Lookup(membership_test_result, entry)) {
+        // Fewer factors than positions means some position is lacked by too many parties and contributed 1.
+        // Otherwise the highest level is the one the loop below would remove last
+        if (entry.factors < options_.num_hash_functions) {
+            return 0;
+        }
+        cnt = options_.num_parties - options_.intersection_threshold + 1 - entry.max_index;
+        return options_.intersection_threshold + cnt - 1;
+    }
+
     NTL::ZZ temp;
     for (auto i = 0; i < options_.num_hash_functions; i++) {
         cnt = 0;
@@ -550,8 +1225,8 @@ void Participant::RingLatency(bool print) {
 void Participant::RingLatencyServer(std::chrono::high_resolution_clock::time_point start, bool print) {
     // dummy write and read
     uint8 dummy[2];
-    endpoint_->Write(rightNeighborName + "_" + std::to_string(0), dummy, sizeof(dummy));
-    endpoint_->Read(leftNeighborName + "_" + std::to_string(0), dummy, sizeof(dummy));
+    endpoint_->Write(right_channels_[0], dummy, sizeof(dummy));
+    endpoint_->Read(left_channels_[0], dummy, sizeof(dummy));
 
     auto end = std::chrono::high_resolution_clock::now();
     if (print) {
@@ -564,51 +1239,96 @@ void Participant::RingLatencyServer(std::chrono::high_resolution_clock::time_poi
 void Participant::RingLatencyClient() {
     // dummy read and write
     uint8 dummy[2];
-    endpoint_->Read(leftNeighborName + "_" + std::to_string(0), dummy, sizeof(dummy));
-    endpoint_->Write(rightNeighborName + "_" + std::to_string(0), dummy, sizeof(dummy));
+    endpoint_->Read(left_channels_[0], dummy, sizeof(dummy));
+    endpoint_->Write(right_channels_[0], dummy, sizeof(dummy));
 }
 
 // Broadcast an NTL::ZZ to all remote participants
 void Participant::BroadcastZz(const NTL::ZZ &n, int channel) {
-    for (const auto &remote: options_.party_list) {
-        if (remote == options_.local_name) {
-            continue;
-        }
-        SendZz(remote, n, channel);
+    for (auto remote: party_channels_[channel]) {
+        SendZz(remote, n);
     }
 }
 
 // Collect NTL::ZZs from all remote participants
 void Participant::CollectZz(std::vector<NTL::ZZ> &zz_array, int channel) {
     NTL::ZZ temp;
-    for (const auto &remote: options_.party_list) {
-        if (remote == options_.local_name) {
-            continue;
-        }
-        ReceiveZz(remote, temp, channel);
+    for (auto remote: party_channels_[channel]) {
+        ReceiveZz(remote, temp);
 
         zz_array.push_back(std::move(temp));
     }
 }
 
+// Method to serialize NTL::ZZs into a framed message: a uint32 count followed by the numbers
+void Participant::PackZzArray(std::vector<uint8> &buf, const std::vector<NTL::ZZ> &zz_array) {
+    uint32 count = zz_array.size();
+    buf.resize(sizeof(count) + count * options_.num_bytes_field_numbers);
+    std::memcpy(buf.data(), &count, sizeof(count));
+    uint8 *payload = buf.data() + sizeof(count);
+    for (const auto &z: zz_array) {
+        BytesFromZZ(payload, z, options_.num_bytes_field_numbers);
+        payload += options_.num_bytes_field_numbers;
+    }
+}
+
+// Send NTL::ZZs to a remote participant as one framed message
+void Participant::SendZzArray(ChannelHandle channel, const std::vector<NTL::ZZ> &zz_array) {
+    std::vector<uint8> buf;
+    PackZzArray(buf, zz_array);
+    endpoint_->Write(channel, buf.data(), buf.size());
+}
+
+// Receive a framed message of at most max_count NTL::ZZs from a remote participant
+void Participant::ReceiveZzArray(ChannelHandle channel, std::vector<NTL::ZZ> &zz_array, uint32 max_count) {
+    uint32 count;
+    endpoint_->Read(channel, &count, sizeof(count));
+    if (count > max_count) {
+        throw std::runtime_error("Received " + std::to_string(count) + " numbers, expected at most " +
+                                 std::to_string(max_count));
+    }
+
+    std::vector<uint8> buf(static_cast<size_t>(count) * options_.num_bytes_field_numbers);
+    endpoint_->Read(channel, buf.data(), buf.size());
+
+    zz_array.resize(count);
+    const uint8 *payload = buf.data();
+    for (auto &z: zz_array) {
+        ZZFromBytes(z, payload, options_.num_bytes_field_numbers);
+        payload += options_.num_bytes_field_numbers;
+    }
+}
+
+// Broadcast NTL::ZZs to all remote participants, one framed message per participant
+void Participant::BroadcastZzArray(const std::vector<NTL::ZZ> &zz_array, int channel) {
+    // serialize once and send the same buffer to everyone
+    std::vector<uint8> buf;
+    PackZzArray(buf, zz_array);
+    for (auto remote: party_channels_[channel]) {
+        endpoint_->Write(remote, buf.data(), buf.size());
+    }
+}
+
+// Collect one framed message of at most max_count NTL::ZZs from every remote participant
+void Participant::CollectZzArray(std::vector<std::vector<NTL::ZZ>> &zz_arrays, int channel, uint32 max_count) {
+    for (auto remote: party_channels_[channel]) {
+        zz_arrays.emplace_back();
+        ReceiveZzArray(remote, zz_arrays.back(), max_count);
+    }
+}
+
 // Broadcast a ciphertext to all remote participants
 void Participant::BroadcastCiphertext(const Ciphertext &ciphertext, int channel) {
-    for (const auto &remote: options_.party_list) {
-        if (remote == options_.local_name) {
-            continue;
-        }
-        SendCiphertext(remote, ciphertext, channel);
+    for (auto remote: party_channels_[channel]) {
+        SendCiphertext(remote, ciphertext);
     }
 }
 
 // Collect ciphertexts from all remote participants
 void Participant::CollectCiphertext(std::vector<Ciphertext> &ciphertext_array, int channel) {
     Ciphertext temp;
-    for (const auto &remote: options_.party_list) {
-        if (remote == options_.local_name) {
-            continue;
-        }
-        ReceiveCiphertext(remote, temp, channel);
+    for (auto remote: party_channels_[channel]) {
+        ReceiveCiphertext(remote, temp);
         ciphertext_array.push_back(std::move(temp));
     }
 }
@@ -1,29 +1,127 @@
 #include "utils/bloom_filter.h"
 
-#include "third_party/smhasher/MurmurHash3.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
 
+#include "utils/murmurhash_batch.h"
 
-std::vector<ContainerSizeType>
-GetHashPositions(const ElementType &e, ContainerSizeType size, const std::vector<uint> &murmurhash_seeds) {
-    std::vector<ContainerSizeType> positions;
-    positions.reserve(murmurhash_seeds.size());
 
-    uint64 hash[2];
-    // Compute multiple hash values for the element using different seeds
-    for (auto &seed: murmurhash_seeds) {
-        MurmurHash3_x86_128(&e, elementTypeWords, seed, hash);
-        ContainerSizeType pos = hash[0] % size;
-        positions.emplace_back(pos);
+const size_t hashBatchSize = 256; // elements hashed per MurmurHashKeys call in the blocked batch path
+
+// Function to turn the hashes of an element under every seed into unblocked positions
+static inline void UnblockedPositions(const uint64 *hashes, ContainerSizeType size, size_t k, ContainerSizeType *out) {
+    for (size_t i = 0; i < k; i++) {
+        out[i] = hashes[2 * i] % size;
+    }
+}
+
+// Function to turn the hash of an element under the first seed into blocked positions.
+// The low half picks the block, the high half gives g1 and g2. g2 is odd and the block size
+// a power of two, so the offsets inside the block are distinct
+static inline void BlockedPositions(const uint64 *hash, ContainerSizeType size, ContainerSizeType block_size,
+                                    size_t k, ContainerSizeType *out) {
+    ContainerSizeType block_start = (hash[0] % (size / block_size)) * block_size;
+    uint64 g1 = hash[1] & 0xffffffff;
+    uint64 g2 = (hash[1] >> 32) | 1;
+    for (size_t i = 0; i < k; i++) {
+        out[i] = block_start + ((g1 + i * g2) & (block_size - 1));
     }
+}
+
+// Function to check that a non-zero block size is a power of two of at least k positions dividing the size,
+// otherwise the k offsets inside a block repeat
+static void CheckBlockSize(ContainerSizeType size, ContainerSizeType block_size, size_t k) {
+    if (block_size != 0 && (!std::has_single_bit(block_size) || block_size < k || size % block_size != 0)) {
+        throw std::invalid_argument("Bloom filter block size must be a power of two of at least " +
+                                    std::to_string(k) + " positions dividing the filter size");
+    }
+}
+
+// Function to write the positions of an element to out, one per MurmurHash seed
+static void HashPositionsInto(const ElementType &e, ContainerSizeType size, const std::vector<uint> &murmurhash_seeds,
+                              ContainerSizeType block_size, ContainerSizeType *out) {
+    if (block_size == 0) {
+        // Compute multiple hash values for the element using different seeds
+        std::vector<uint64> hashes(2 * murmurhash_seeds.size());
+        MurmurHashSeeds(e, murmurhash_seeds.data(), murmurhash_seeds.size(), hashes.data());
+        UnblockedPositions(hashes.data(), size, murmurhash_seeds.size(), out);
+        return;
+    }
+
+    // One hash for all positions
+    uint64 hash[2];
+    MurmurHashKeys(&e, 1, murmurhash_seeds[0], hash);
+    BlockedPositions(hash, size, block_size, murmurhash_seeds.size(), out);
+}
 
+// Method to get all the hashed positions using the murmurhash seeds
+std::vector<ContainerSizeType>
+GetHashPositions(const ElementType &e, ContainerSizeType size, const std::vector<uint> &murmurhash_seeds,
+                 ContainerSizeType block_size) {
+    CheckBlockSize(size, block_size, murmurhash_seeds.size());
+    std::vector<ContainerSizeType> positions(murmurhash_seeds.size());
+    HashPositionsInto(e, size, murmurhash_seeds, block_size, positions.data());
     return positions;
 }
 
+// Constructor that takes the size of the filter, a vector of MurmurHash seeds and the block size
+BloomFilter::BloomFilter(const ContainerSizeType &size, const std::vector<uint32> &murmurhash_seeds,
+                         ContainerSizeType block_size)
+        : size_(size), bit_array_(boost::dynamic_bitset<>(size)), murmurhash_seeds_(murmurhash_seeds),
+          block_size_(block_size) {
+    CheckBlockSize(size_, block_size_, murmurhash_seeds_.size());
+}
+
+// Method to compute the positions of an element, one per MurmurHash seed
+void BloomFilter::HashPositions(const ElementType &e, std::vector<ContainerSizeType> &positions) const {
+    positions.resize(murmurhash_seeds_.size());
+    HashPositionsInto(e, size_, murmurhash_seeds_, block_size_, positions.data());
+}
+
+// Method to compute the positions of all elements into a row-major matrix with num_hashes() columns
+void BloomFilter::HashPositions(const std::vector<ElementType> &elements, std::vector<ContainerSizeType> &positions,
+                                ThreadPool &pool) const {
+    const size_t k = murmurhash_seeds_.size();
+    positions.resize(elements.size() * k);
+
+    // Chunks of hashBatchSize elements keep the kernel batches full
+    pool.ParallelFor(0, elements.size(), [&](size_t start, size_t end, size_t) {
+        std::vector<uint64> hashes;
+        if (block_size_ == 0) {
+            // All seeds of one element per kernel call
+            hashes.resize(2 * k);
+            for (auto i = start; i < end; i++) {
+                MurmurHashSeeds(elements[i], murmurhash_seeds_.data(), k, hashes.data());
+                UnblockedPositions(hashes.data(), size_, k, positions.data() + i * k);
+            }
+            return;
+        }
+
+        // Up to hashBatchSize elements under the first seed per kernel call
+        hashes.resize(2 * hashBatchSize);
+        for (auto i = start; i < end; i += hashBatchSize) {
+            size_t count = std::min(hashBatchSize, end - i);
+            MurmurHashKeys(elements.data() + i, count, murmurhash_seeds_[0], hashes.data());
+            for (size_t j = 0; j < count; j++) {
+                BlockedPositions(hashes.data() + 2 * j, size_, block_size_, k, positions.data() + (i + j) * k);
+            }
+        }
+    }, hashBatchSize);
+}
+
+// Method to insert elements given by a position matrix from the batch HashPositions
+void BloomFilter::InsertPositions(const std::vector<ContainerSizeType> &positions) {
+    for (auto pos: positions) {
+        bit_array_[pos] = 1;
+    }
+}
 
 // Method to insert an element into the Bloom filter
 void BloomFilter::Insert(const ElementType &e) {
     // Set all positions to 1
-    for (auto pos: GetHashPositions(e, size_, murmurhash_seeds_)) {
+    for (auto pos: GetHashPositions(e, size_, murmurhash_seeds_, block_size_)) {
         bit_array_[pos] = 1;
     }
 }
@@ -31,7 +129,7 @@ void BloomFilter::Insert(const ElementType &e) {
 // Method to check if an element is in the Bloom filter
 bool BloomFilter::CheckElement(const ElementType &e) {
     // Check whether all the positions are 1
-    for (auto pos: GetHashPositions(e, size_, murmurhash_seeds_)) {
+    for (auto pos: GetHashPositions(e, size_, murmurhash_seeds_, block_size_)) {
         if (bit_array_[pos] == 0) {
             return false;
         }
@@ -0,0 +1,76 @@
+#include "utils/miss_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+#ifdef __linux__
+
+// Function to open and start a counter of one hardware event for the calling thread, -1 if refused
+static int OpenCounter(uint32 type, uint64 config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+// Constructor that opens and starts the counters for the calling thread
+MissCounters::MissCounters() {
+    fds_[0] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    fds_[1] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds_[2] = OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+// Destructor that closes the counters
+MissCounters::~MissCounters() {
+    for (int fd: fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+// Method to read the counts since construction
+MissCounters::Counts MissCounters::Read() const {
+    uint64 values[kEvents] = {0, 0, 0};
+    for (int i = 0; i < kEvents; i++) {
+        if (fds_[i] >= 0 && read(fds_[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+            values[i] = 0;
+        }
+    }
+    return Counts{values[0], values[1], values[2]};
+}
+
+#else
+
+// Constructor, there are no counters off Linux
+MissCounters::MissCounters() = default;
+
+// Default destructor
+MissCounters::~MissCounters() = default;
+
+// Method to read the counts, always 0 off Linux
+MissCounters::Counts MissCounters::Read() const {
+    return Counts{0, 0, 0};
+}
+
+#endif // __linux__
+
+// Method to check if the kernel granted all counters
+bool MissCounters::available() const {
+    for (int fd: fds_) {
+        if (fd < 0) {
+            return false;
+        }
+    }
+    return true;
+}
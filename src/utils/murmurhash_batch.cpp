@@ -0,0 +1,216 @@
+#include "utils/murmurhash_batch.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OTMPSI_MURMURHASH_SIMD
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(ElementType) == 4, "the batched MurmurHash kernels hash 4-byte keys");
+
+const uint32 murmurC1 = 0x239b961b;
+const uint32 murmurC2 = 0xab0e9789;
+const uint32 murmurKeyBytes = 4;
+
+// Kernel hashing lane i as keys[i * key_step] with seeds[i * seed_step], a step of 0 repeats the first value
+typedef void (*MurmurHashKernel)(const uint32 *keys, size_t key_step, const uint32 *seeds, size_t seed_step,
+                                 size_t count, uint64 *out);
+
+static inline uint32 Rotl32(uint32 x, int r) { return (x << r) | (x >> (32 - r)); }
+
+static inline uint32 Fmix32(uint32 h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// Function to hash one 4-byte key. There are no 16-byte blocks, and the tail only touches h1, so h2, h3
+// and h4 stay equal through the finalization and only two fmix32 calls are needed
+static inline void HashLane(uint32 key, uint32 seed, uint64 *out) {
+    uint32 k1 = Rotl32(key * murmurC1, 15) * murmurC2;
+    uint32 h1 = seed ^ k1 ^ murmurKeyBytes;
+    uint32 h2 = seed ^ murmurKeyBytes;
+
+    h1 += 3 * h2;
+    h2 += h1;
+    h1 = Fmix32(h1);
+    h2 = Fmix32(h2);
+    h1 += 3 * h2;
+    h2 += h1;
+
+    out[0] = h1 | (static_cast<uint64>(h2) << 32);
+    out[1] = h2 | (static_cast<uint64>(h2) << 32);
+}
+
+static void HashScalar(const uint32 *keys, size_t key_step, const uint32 *seeds, size_t seed_step,
+                       size_t count, uint64 *out) {
+    for (size_t i = 0; i < count; i++) {
+        HashLane(keys[i * key_step], seeds[i * seed_step], out + 2 * i);
+    }
+}
+
+#ifdef OTMPSI_MURMURHASH_SIMD
+
+__attribute__((target("avx2")))
+static inline __m256i Fmix32Avx2(__m256i h) {
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(0x85ebca6b)));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(static_cast<int>(0xc2b2ae35)));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx2")))
+static void HashAvx2(const uint32 *keys, size_t key_step, const uint32 *seeds, size_t seed_step,
+                     size_t count, uint64 *out) {
+    const __m256i c1 = _mm256_set1_epi32(static_cast<int>(murmurC1));
+    const __m256i c2 = _mm256_set1_epi32(static_cast<int>(murmurC2));
+    const __m256i len = _mm256_set1_epi32(murmurKeyBytes);
+    const __m256i key_splat = _mm256_set1_epi32(static_cast<int>(keys[0]));
+    const __m256i seed_splat = _mm256_set1_epi32(static_cast<int>(seeds[0]));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i k1 = key_step ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)) : key_splat;
+        __m256i seed = seed_step ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(seeds + i)) : seed_splat;
+
+        k1 = _mm256_mullo_epi32(k1, c1);
+        k1 = _mm256_or_si256(_mm256_slli_epi32(k1, 15), _mm256_srli_epi32(k1, 17));
+        k1 = _mm256_mullo_epi32(k1, c2);
+        __m256i h2 = _mm256_xor_si256(seed, len);
+        __m256i h1 = _mm256_xor_si256(h2, k1);
+
+        h1 = _mm256_add_epi32(h1, _mm256_add_epi32(h2, _mm256_add_epi32(h2, h2)));
+        h2 = _mm256_add_epi32(h2, h1);
+        h1 = Fmix32Avx2(h1);
+        h2 = Fmix32Avx2(h2);
+        h1 = _mm256_add_epi32(h1, _mm256_add_epi32(h2, _mm256_add_epi32(h2, h2)));
+        h2 = _mm256_add_epi32(h2, h1);
+
+        // Interleave into the output words {h1 | h2 << 32, h2 | h2 << 32} of each lane.
+        // The unpacks work inside 128-bit halves, so a0 holds lanes 0 and 4, a1 lanes 1 and 5, and so on
+        __m256i lo = _mm256_unpacklo_epi32(h1, h2);
+        __m256i hi = _mm256_unpackhi_epi32(h1, h2);
+        __m256i lo2 = _mm256_unpacklo_epi32(h2, h2);
+        __m256i hi2 = _mm256_unpackhi_epi32(h2, h2);
+        __m256i a0 = _mm256_unpacklo_epi64(lo, lo2);
+        __m256i a1 = _mm256_unpackhi_epi64(lo, lo2);
+        __m256i a2 = _mm256_unpacklo_epi64(hi, hi2);
+        __m256i a3 = _mm256_unpackhi_epi64(hi, hi2);
+
+        auto *dst = reinterpret_cast<__m256i *>(out + 2 * i);
+        _mm256_storeu_si256(dst + 0, _mm256_permute2x128_si256(a0, a1, 0x20));
+        _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(a2, a3, 0x20));
+        _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(a0, a1, 0x31));
+        _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(a2, a3, 0x31));
+    }
+    HashScalar(keys + i * key_step, key_step, seeds + i * seed_step, seed_step, count - i, out + 2 * i);
+}
+
+// GCC 12 reports the _mm512_undefined_epi32 placeholders inside the AVX-512 intrinsics as uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static inline __m512i Fmix32Avx512(__m512i h) {
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32(static_cast<int>(0x85ebca6b)));
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32(static_cast<int>(0xc2b2ae35)));
+    return _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx512f")))
+static void HashAvx512(const uint32 *keys, size_t key_step, const uint32 *seeds, size_t seed_step,
+                       size_t count, uint64 *out) {
+    const __m512i c1 = _mm512_set1_epi32(static_cast<int>(murmurC1));
+    const __m512i c2 = _mm512_set1_epi32(static_cast<int>(murmurC2));
+    const __m512i len = _mm512_set1_epi32(murmurKeyBytes);
+    const __m512i key_splat = _mm512_set1_epi32(static_cast<int>(keys[0]));
+    const __m512i seed_splat = _mm512_set1_epi32(static_cast<int>(seeds[0]));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i k1 = key_step ? _mm512_loadu_si512(keys + i) : key_splat;
+        __m512i seed = seed_step ? _mm512_loadu_si512(seeds + i) : seed_splat;
+
+        k1 = _mm512_mullo_epi32(_mm512_rol_epi32(_mm512_mullo_epi32(k1, c1), 15), c2);
+        __m512i h2 = _mm512_xor_si512(seed, len);
+        __m512i h1 = _mm512_xor_si512(h2, k1);
+
+        h1 = _mm512_add_epi32(h1, _mm512_add_epi32(h2, _mm512_add_epi32(h2, h2)));
+        h2 = _mm512_add_epi32(h2, h1);
+        h1 = Fmix32Avx512(h1);
+        h2 = Fmix32Avx512(h2);
+        h1 = _mm512_add_epi32(h1, _mm512_add_epi32(h2, _mm512_add_epi32(h2, h2)));
+        h2 = _mm512_add_epi32(h2, h1);
+
+        // Same interleave as the AVX2 kernel: the 128-bit chunks of a0 hold lanes 0, 4, 8 and 12,
+        // those of a1 lanes 1, 5, 9 and 13, and so on. Two rounds of chunk shuffles put them in order
+        __m512i lo = _mm512_unpacklo_epi32(h1, h2);
+        __m512i hi = _mm512_unpackhi_epi32(h1, h2);
+        __m512i lo2 = _mm512_unpacklo_epi32(h2, h2);
+        __m512i hi2 = _mm512_unpackhi_epi32(h2, h2);
+        __m512i a0 = _mm512_unpacklo_epi64(lo, lo2);
+        __m512i a1 = _mm512_unpackhi_epi64(lo, lo2);
+        __m512i a2 = _mm512_unpacklo_epi64(hi, hi2);
+        __m512i a3 = _mm512_unpackhi_epi64(hi, hi2);
+        __m512i t0 = _mm512_shuffle_i64x2(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)); // lanes 0, 8, 1, 9
+        __m512i t1 = _mm512_shuffle_i64x2(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)); // lanes 4, 12, 5, 13
+        __m512i t2 = _mm512_shuffle_i64x2(a2, a3, _MM_SHUFFLE(2, 0, 2, 0)); // lanes 2, 10, 3, 11
+        __m512i t3 = _mm512_shuffle_i64x2(a2, a3, _MM_SHUFFLE(3, 1, 3, 1)); // lanes 6, 14, 7, 15
+
+        uint64 *dst = out + 2 * i;
+        _mm512_storeu_si512(dst + 0, _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm512_storeu_si512(dst + 8, _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm512_storeu_si512(dst + 16, _mm512_shuffle_i64x2(t0, t2, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm512_storeu_si512(dst + 24, _mm512_shuffle_i64x2(t1, t3, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    HashScalar(keys + i * key_step, key_step, seeds + i * seed_step, seed_step, count - i, out + 2 * i);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // OTMPSI_MURMURHASH_SIMD
+
+// Struct for the kernel selected for this CPU
+struct MurmurHashKernelChoice {
+    MurmurHashKernel kernel;
+    const char *name;
+};
+
+// Function to select the widest kernel the CPU supports, once
+static const MurmurHashKernelChoice &SelectedKernel() {
+    static const MurmurHashKernelChoice choice = [] {
+#ifdef OTMPSI_MURMURHASH_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return MurmurHashKernelChoice{HashAvx512, "avx512"};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return MurmurHashKernelChoice{HashAvx2, "avx2"};
+        }
+#endif
+        return MurmurHashKernelChoice{HashScalar, "scalar"};
+    }();
+    return choice;
+}
+
+// Function to hash count keys with the same seed
+void MurmurHashKeys(const ElementType *keys, size_t count, uint32 seed, uint64 *out) {
+    if (count != 0) {
+        SelectedKernel().kernel(keys, 1, &seed, 0, count, out);
+    }
+}
+
+// Function to hash one key with count seeds
+void MurmurHashSeeds(ElementType key, const uint32 *seeds, size_t count, uint64 *out) {
+    if (count != 0) {
+        SelectedKernel().kernel(&key, 0, seeds, 1, count, out);
+    }
+}
+
+// Function to get the name of the kernel selected for this CPU
+const char *MurmurHashKernelName() { return SelectedKernel().name; }
@@ -0,0 +1,149 @@
+#include "utils/preprocessing_store.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+const char preprocessingStoreMagic[8] = {'O', 'T', 'M', 'P', 'S', 'I', 'P', 'P'};
+
+// Function to throw the current errno as an exception
+static void ThrowErrno(const std::string &what, const std::string &path) {
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+// Struct holding an exclusive flock on a file for its lifetime
+struct StoreLock {
+    explicit StoreLock(int fd) : fd(fd) { flock(fd, LOCK_EX); }
+
+    ~StoreLock() { flock(fd, LOCK_UN); }
+
+    int fd;
+};
+
+// Struct for a mapping of a byte range of a file, which mmap needs to start on a page boundary
+struct BundleMapping {
+    BundleMapping(int fd, uint64 offset, uint64 len, uint64 page_bytes, int prot) {
+        uint64 start = offset - offset % page_bytes;
+        map_bytes = len + (offset - start);
+        mapping = mmap(nullptr, map_bytes, prot, MAP_SHARED, fd, start);
+        data = mapping == MAP_FAILED ? nullptr : static_cast<uint8 *>(mapping) + (offset - start);
+    }
+
+    ~BundleMapping() {
+        if (mapping != MAP_FAILED) {
+            munmap(mapping, map_bytes);
+        }
+    }
+
+    void *mapping;
+    uint64 map_bytes;
+    uint8 *data;
+};
+
+// Constructor that takes the open file and its mapped header
+PreprocessingStore::PreprocessingStore(int fd, std::string path, uint64 page_bytes, PreprocessingStoreHeader *header)
+        : fd_(fd), path_(std::move(path)), page_bytes_(page_bytes), header_(header) {}
+
+// Unmaps the header and closes the file
+PreprocessingStore::~PreprocessingStore() {
+    munmap(header_, page_bytes_);
+    close(fd_);
+}
+
+// Factory method to open or create the store at path for bundles of bundle_bytes bytes
+std::unique_ptr<PreprocessingStore>
+PreprocessingStore::Open(const std::string &path, uint64 fingerprint, uint64 bundle_bytes) {
+    uint64 page_bytes = sysconf(_SC_PAGESIZE);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        ThrowErrno("Cannot open preprocessing store", path);
+    }
+
+    StoreLock lock(fd);
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (static_cast<uint64>(st.st_size) < page_bytes && ftruncate(fd, page_bytes) != 0)) {
+        close(fd);
+        ThrowErrno("Cannot size preprocessing store", path);
+    }
+    void *mapping = mmap(nullptr, page_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        ThrowErrno("Cannot map preprocessing store", path);
+    }
+
+    // Bundles made for another key, other parameters or an older layout cannot be used
+    auto header = static_cast<PreprocessingStoreHeader *>(mapping);
+    if (std::memcmp(header->magic, preprocessingStoreMagic, sizeof(header->magic)) != 0 ||
+        header->version != preprocessingStoreVersion || header->fingerprint != fingerprint ||
+        header->bundle_bytes != bundle_bytes) {
+        std::memset(header, 0, sizeof(PreprocessingStoreHeader));
+        std::memcpy(header->magic, preprocessingStoreMagic, sizeof(header->magic));
+        header->version = preprocessingStoreVersion;
+        header->fingerprint = fingerprint;
+        header->bundle_bytes = bundle_bytes;
+        if (ftruncate(fd, page_bytes) != 0) {
+            munmap(mapping, page_bytes);
+            close(fd);
+            ThrowErrno("Cannot truncate preprocessing store", path);
+        }
+    }
+
+    return std::unique_ptr<PreprocessingStore>(new PreprocessingStore(fd, path, page_bytes, header));
+}
+
+// Method to append one bundle of bundle_bytes bytes
+void PreprocessingStore::Append(const uint8 *bundle) {
+    StoreLock lock(fd_);
+
+    // Reclaim the space once every bundle has been consumed
+    if (header_->generated > 0 && header_->consumed == header_->generated) {
+        header_->generated = 0;
+        header_->consumed = 0;
+        if (ftruncate(fd_, page_bytes_) != 0) {
+            ThrowErrno("Cannot truncate preprocessing store", path_);
+        }
+    }
+
+    uint64 offset = BundleOffset(header_->generated);
+    if (ftruncate(fd_, offset + header_->bundle_bytes) != 0) {
+        ThrowErrno("Cannot grow preprocessing store", path_);
+    }
+    BundleMapping bundle_mapping(fd_, offset, header_->bundle_bytes, page_bytes_, PROT_READ | PROT_WRITE);
+    if (bundle_mapping.data == nullptr) {
+        ThrowErrno("Cannot map preprocessing bundle", path_);
+    }
+    std::memcpy(bundle_mapping.data, bundle, header_->bundle_bytes);
+
+    // The bundle is complete before it becomes visible to Take
+    header_->generated++;
+}
+
+// Method to take the oldest fresh bundle into buf
+bool PreprocessingStore::Take(uint8 *buf) {
+    // The lock stays held while reading, so Append cannot truncate the bundle away
+    StoreLock lock(fd_);
+    if (header_->consumed >= header_->generated) {
+        return false;
+    }
+
+    uint64 index = header_->consumed++;
+    BundleMapping bundle_mapping(fd_, BundleOffset(index), header_->bundle_bytes, page_bytes_, PROT_READ);
+    if (bundle_mapping.data == nullptr) {
+        ThrowErrno("Cannot map preprocessing bundle", path_);
+    }
+    madvise(bundle_mapping.mapping, bundle_mapping.map_bytes, MADV_SEQUENTIAL);
+    std::memcpy(buf, bundle_mapping.data, header_->bundle_bytes);
+    return true;
+}
+
+// Method to get the number of fresh bundles
+uint64 PreprocessingStore::Available() {
+    StoreLock lock(fd_);
+    return header_->generated - header_->consumed;
+}
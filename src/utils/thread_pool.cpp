@@ -0,0 +1,280 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Number of chunks per worker when ParallelFor picks the chunk size
+const size_t threadPoolChunksPerWorker = 8;
+
+// Parse a sysfs CPU list such as "0-3,8-11"
+static std::vector<int> ParseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Get the CPUs this process may run on by NUMA node, a single node of all of them if the topology is unknown
+static std::vector<std::vector<int>> NumaNodeCpus() {
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return nodes;
+    }
+    for (int node = 0;; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int cpu: ParseCpuList(list)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+    if (nodes.empty()) {
+        nodes.emplace_back();
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                nodes.back().push_back(cpu);
+            }
+        }
+    }
+#endif
+    return nodes;
+}
+
+// Constructor that starts num_threads workers, at least one, and pins them to cores if pin is set
+ThreadPool::ThreadPool(size_t num_threads, bool pin) : stats_start_(std::chrono::steady_clock::now()) {
+    num_threads = std::max<size_t>(num_threads, 1);
+    for (size_t i = 0; i < num_threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        threads_.emplace_back(&ThreadPool::Run, this, i);
+    }
+    if (pin) {
+        PinWorkers();
+    }
+}
+
+// Method to pin every worker to a core, filling the NUMA nodes in order
+void ThreadPool::PinWorkers() {
+#ifdef __linux__
+    std::vector<std::vector<int>> nodes = NumaNodeCpus();
+    if (nodes.empty()) {
+        std::cerr << "CPU topology unavailable, worker threads are not pinned" << std::endl;
+        return;
+    }
+
+    // Worker i goes to node i * nodes / workers, so every node gets a contiguous run of workers and with
+    // them a contiguous part of every range. Workers beyond the cores of a node share its cores
+    size_t n = workers_.size();
+    size_t used_nodes = std::min(nodes.size(), n);
+    for (size_t i = 0; i < n; i++) {
+        size_t node = i * used_nodes / n;
+        size_t first = (node * n + used_nodes - 1) / used_nodes; // first worker on the node
+        int cpu = nodes[node][(i - first) % nodes[node].size()];
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(threads_[i].native_handle(), sizeof(set), &set) != 0) {
+            std::cerr << "Failed to pin worker " << i << " to CPU " << cpu << std::endl;
+        }
+        workers_[i]->node = node;
+    }
+    pinned_ = true;
+    num_nodes_ = used_nodes;
+#else
+    std::cerr << "Pinning worker threads needs Linux, workers are not pinned" << std::endl;
+#endif
+}
+
+// Destructor that stops and joins the workers
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &th: threads_) {
+        th.join();
+    }
+}
+
+// Method to run body over [begin, end) on the workers and wait for it
+void ThreadPool::ParallelFor(size_t begin, size_t end, const RangeFunction &body, size_t chunk) {
+    if (begin >= end) {
+        return;
+    }
+    std::lock_guard<std::mutex> call_lock(call_mtx_);
+
+    // Hand out equal contiguous slices, the workers are idle so their slices can be set without races
+    size_t total = end - begin;
+    size_t per_worker = total / workers_.size();
+    for (size_t i = 0; i < workers_.size(); i++) {
+        std::lock_guard<std::mutex> lock(workers_[i]->mtx);
+        workers_[i]->next = begin + i * per_worker;
+        workers_[i]->end = (i == workers_.size() - 1) ? end : workers_[i]->next + per_worker;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    body_ = &body;
+    chunk_ = chunk > 0 ? chunk : std::max<size_t>(1, total / (workers_.size() * threadPoolChunksPerWorker));
+    error_ = nullptr;
+    running_ = workers_.size();
+    generation_++;
+    start_cv_.notify_all();
+    done_cv_.wait(lock, [this] { return running_ == 0; });
+    body_ = nullptr;
+
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+// Main loop of a worker thread
+void ThreadPool::Run(size_t worker) {
+    uint64 seen_generation = 0;
+    Worker &self = *workers_[worker];
+    while (true) {
+        const RangeFunction *body;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+            body = body_;
+        }
+
+        size_t start, end;
+        while (NextChunk(worker, start, end)) {
+            auto begin_time = std::chrono::steady_clock::now();
+            try {
+                (*body)(start, end, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            self.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - begin_time).count();
+            self.chunks++;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (--running_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
+
+// Method to take the next chunk for a worker from its own slice or by stealing
+bool ThreadPool::NextChunk(size_t worker, size_t &start, size_t &end) {
+    Worker &self = *workers_[worker];
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(self.mtx);
+            if (self.next < self.end) {
+                start = self.next;
+                end = std::min(self.end, self.next + chunk_);
+                self.next = end;
+                return true;
+            }
+        }
+
+        // Find the worker with the most work left, on the same node if any has work left
+        size_t victim = workers_.size();
+        size_t most_left = 0;
+        bool victim_local = false;
+        for (size_t i = 0; i < workers_.size(); i++) {
+            if (i == worker) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(workers_[i]->mtx);
+            size_t left = workers_[i]->end - workers_[i]->next;
+            bool local = workers_[i]->node == self.node;
+            if (left > 0 && ((local && !victim_local) || (local == victim_local && left > most_left))) {
+                most_left = left;
+                victim = i;
+                victim_local = local;
+            }
+        }
+        if (victim == workers_.size()) {
+            return false;
+        }
+
+        // Steal the back half of its slice, the victim keeps working on the front
+        size_t stolen_start, stolen_end;
+        {
+            std::lock_guard<std::mutex> lock(workers_[victim]->mtx);
+            size_t left = workers_[victim]->end - workers_[victim]->next;
+            if (left == 0) {
+                continue;
+            }
+            stolen_end = workers_[victim]->end;
+            stolen_start = stolen_end - (left + 1) / 2;
+            workers_[victim]->end = stolen_start;
+        }
+        self.steals++;
+        std::lock_guard<std::mutex> lock(self.mtx);
+        self.next = stolen_start;
+        self.end = stolen_end;
+    }
+}
+
+// Method to get the counters of every worker
+std::vector<ThreadPool::WorkerStats> ThreadPool::Stats() const {
+    std::vector<WorkerStats> stats;
+    stats.reserve(workers_.size());
+    for (const auto &w: workers_) {
+        stats.push_back(WorkerStats{w->busy_ns.load(), w->chunks.load(), w->steals.load(), w->node});
+    }
+    return stats;
+}
+
+// Method to get the time since the last ResetStats
+uint64 ThreadPool::ElapsedNanoseconds() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stats_start_).count();
+}
+
+// Method to reset the counters of every worker
+void ThreadPool::ResetStats() {
+    for (auto &w: workers_) {
+        w->busy_ns = 0;
+        w->chunks = 0;
+        w->steals = 0;
+    }
+    stats_start_ = std::chrono::steady_clock::now();
+}
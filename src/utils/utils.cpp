@@ -18,6 +18,7 @@ void NewConfigFromJsonFile(ExperimentConfig &config, const std::string &json_fil
     // Set the values of the experiment configuration from the JSON object
     config.element_set_size = cJson["setSize"].get<ContainerSizeType>();
     config.options.bloom_filter_size = cJson["bloomFilterSize"].get<ContainerSizeType>();
+    config.options.bloom_filter_block_size = cJson.value("bloomFilterBlockSize", 0);
     config.options.false_positive_rate = cJson["falsePositiveRate"].get<ContainerSizeType>();
     config.num_same_items = cJson["sameNum"].get<ContainerSizeType>();
     config.same_item_seed = cJson["sameSeed"].get<uint32>();
@@ -43,6 +44,24 @@ void NewConfigFromJsonFile(ExperimentConfig &config, const std::string &json_fil
     config.options.power_q = NTL::conv<NTL::ZZ>(cJson["qPower"].get<std::string>().c_str());
     config.options.alpha = NTL::conv<NTL::ZZ>(cJson["alpha"].get<std::string>().c_str());
     config.options.num_bytes_field_numbers = cJson["bufferSize"].get<int>();
+    config.options.fixed_base_window_bits = cJson.value("fixedBaseWindowBits", defaultFixedBaseWindowBits);
+    config.options.short_exponent_bits = cJson.value("shortExponentBits", 0);
+    config.options.simd_mul_mod = cJson.value("simdMulMod", simdMulModAuto);
+    config.options.ring_pass_chunk_size = cJson.value("ringPassChunkSize", defaultRingPassChunkSize);
+    config.options.max_in_flight_bytes = cJson.value("maxInFlightBytes", defaultMaxInFlightBytes);
+    config.options.network_backend = cJson.value("networkBackend", networkBackendTcp);
+    config.options.zero_copy_send = cJson.value("zeroCopySend", false);
+    config.options.dlog_table_max_entries = cJson.value("dlogTableMaxEntries", defaultDlogTableMaxEntries);
+    config.options.rerand_pool_size = cJson.value("rerandPoolSize", 0);
+    config.options.rerand_subset_size = cJson.value("rerandSubsetSize", 0);
+    config.options.preprocessing_dir = cJson.value("preprocessingDir", "");
+    config.options.num_worker_threads = cJson.value("numWorkerThreads", 0);
+    config.options.pin_worker_threads = cJson.value("pinWorkerThreads", false);
+    config.options.stream_prepare = cJson.value("streamPrepare", false);
+    config.options.connections_per_peer = cJson.value("connectionsPerPeer", 0);
+    config.options.memory_budget_mb = cJson.value("memoryBudgetMb", 0);
+    config.options.spill_dir = cJson.value("spillDir", "");
+    config.options.membership_test_tile_size = cJson.value("membershipTestTileSize", defaultMembershipTestTileSize);
 
     // Convert the prime factors of p from strings to NTL::ZZ
     std::vector<std::string> strs = (cJson["phiPPrimeFactors"].get<std::vector<std::string>>());
@@ -58,7 +77,7 @@ void generate_set(std::vector<ElementType> &set, const ExperimentConfig &config)
 
     // Generate the same elements using the same seed
     NTL::SetSeed(NTL::conv<NTL::ZZ>(config.same_item_seed));
-    for (auto i = 0; i < config.num_same_items; i++) {
+    for (ContainerSizeType i = 0; i < config.num_same_items; i++) {
         NTL::RandomBnd(random_num, elementTypeMax);
         set.emplace_back(random_num);
     }
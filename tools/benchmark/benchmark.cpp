@@ -1,6 +1,8 @@
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
+#include <thread>
 
 #include "protocol/participant.h"
 #include "third_party/smhasher/MurmurHash3.h"
@@ -35,8 +37,11 @@ int main(int argc, char *argv[]) {
     participant.RingLatency(false);
     participant.RingLatency(true);
 
+    // Count the worker utilization over the rounds only
+    participant.pool().ResetStats();
+
     srand(time(0));
-    for (auto i = 0; i < config.benchmark_rounds; i++) {
+    for (uint32 i = 0; i < config.benchmark_rounds; i++) {
         config.same_item_seed += 1;
         config.diff_item_seed += rand();
         generate_set(set, config);
@@ -45,6 +50,8 @@ int main(int argc, char *argv[]) {
         durations.emplace_back(participant.Execute(false));
     }
     participant.Stop();
+    uint64 pool_elapsed_ns = participant.pool().ElapsedNanoseconds();
+    std::vector<ThreadPool::WorkerStats> pool_stats = participant.pool().Stats();
 
     if (config.options.role == Role::server) {
         auto online_avg = 0;
@@ -78,6 +85,10 @@ int main(int argc, char *argv[]) {
         ss << "-----------------------------------\n"
            << "Benchmark rounds: " << config.benchmark_rounds << "\n"
            << "Concurrency level: " << config.options.concurrency_level << "\n"
+           << "Worker threads: " << pool_stats.size() << "\n"
+           << "Worker pinning: "
+           << (participant.pool().pinned() ? "on, " + std::to_string(participant.pool().num_nodes()) + " NUMA node(s)"
+                                           : std::string("off")) << "\n"
            << "-----------------------------------\n"
            << std::left << std::setw(26) << "Number of participants: " << config.options.num_parties << "\n"
            << std::left << std::setw(26) << "Intersection threshold: " << config.options.intersection_threshold
@@ -93,7 +104,34 @@ int main(int argc, char *argv[]) {
            << std::left << std::setw(26) << "Server data sent: " << FormatBytes(participant.GetTotalBytesSent())
            << " \n"
            << std::left << std::setw(26) << "Server data received: "
-           << FormatBytes(participant.GetTotalBytesReceived()) << "\n";
+           << FormatBytes(participant.GetTotalBytesReceived()) << "\n"
+           << "-----------------------------------\n";
+
+        // Share of the rounds each worker spent in loop bodies, the rest is waiting on the network
+        for (size_t i = 0; i < pool_stats.size(); i++) {
+            ss << std::left << std::setw(26) << ("Worker " + std::to_string(i) + " utilization: ") << std::fixed
+               << std::setprecision(1) << 100.0 * pool_stats[i].busy_ns / pool_elapsed_ns << "% ("
+               << pool_stats[i].chunks << " chunks, " << pool_stats[i].steals << " steals";
+            if (participant.pool().pinned()) {
+                ss << ", node " << pool_stats[i].node;
+            }
+            ss << ")\n";
+        }
+
+        // Hardware misses of the membership tests per element, they depend on the order the bases are read in
+        const MissCounters::Counts &misses = participant.membership_test_misses();
+        ss << "-----------------------------------\n"
+           << std::left << std::setw(26) << "Membership test tiles: " << config.options.membership_test_tile_size
+           << (config.options.membership_test_tile_size == 0 ? " (input order)" : " elements") << "\n";
+        if (misses.cache_references == 0 && misses.cache_misses == 0 && misses.dtlb_misses == 0) {
+            ss << "Membership test misses: perf counters unavailable\n";
+        } else {
+            double tests = static_cast<double>(config.benchmark_rounds) * set.size();
+            ss << std::left << std::setw(26) << "LLC misses per element: " << misses.cache_misses / tests << "\n"
+               << std::left << std::setw(26) << "LLC miss rate: "
+               << 100.0 * misses.cache_misses / std::max<uint64>(misses.cache_references, 1) << "%\n"
+               << std::left << std::setw(26) << "dTLB misses per element: " << misses.dtlb_misses / tests << "\n";
+        }
         std::string str = ss.str();
         std::cout << str << std::endl;
     }
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "crypto/threshold_elgamal.h"
+#include "utils/common.h"
+#include "utils/utils.h"
+
+const int defaultRounds = 200;
+const int mulRoundsFactor = 100;
+const int batchSize = 256;
+
+// Struct for the per-operation timings of an arithmetic backend in milliseconds
+struct BackendTimings {
+    double mul;
+    double power;
+    double mul_batch;
+    double power_batch;
+    double partial_decrypt;
+};
+
+// Function to time Mul, Power by q, their batched forms and PartialDecrypt of a backend in milliseconds
+// per operation
+template<typename Backend>
+BackendTimings TimeBackend(const Options &options, int rounds) {
+    typedef BasicKeyHolder<Backend> Holder;
+    Holder key_holder(options.p, options.alpha, options.phi_p_prime_factor_list);
+    key_holder.SetBatchIsa(options.simd_mul_mod);
+
+    typename Holder::Ciphertext c, d;
+    typename Holder::Number m, share;
+    key_holder.backend().FromZz(m, NTL::ZZ(2));
+    key_holder.Encrypt(c, m);
+    d = c;
+
+    BackendTimings timings{};
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds * mulRoundsFactor; i++) {
+        key_holder.Mul(d, d, c);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    timings.mul = std::chrono::duration<double, std::milli>(end - start).count() / (rounds * mulRoundsFactor);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds * mulRoundsFactor; i++) {
+        key_holder.Power(d, d, options.q);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    timings.power = std::chrono::duration<double, std::milli>(end - start).count() / (rounds * mulRoundsFactor);
+
+    // The batches take as many operations as the loops above
+    std::vector<typename Holder::Ciphertext> batch(batchSize, c), factors(batchSize, c);
+    std::vector<typename Holder::Ciphertext *> pointers(batchSize);
+    for (int i = 0; i < batchSize; i++) {
+        pointers[i] = &batch[i];
+    }
+    int batches = std::max(1, rounds * mulRoundsFactor / batchSize);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < batches; i++) {
+        key_holder.MulBatch(batch.data(), batch.data(), factors.data(), batchSize);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    timings.mul_batch = std::chrono::duration<double, std::milli>(end - start).count() / (batches * batchSize);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < batches; i++) {
+        key_holder.PowerBatch(pointers.data(), pointers.data(), options.q, batchSize);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    timings.power_batch = std::chrono::duration<double, std::milli>(end - start).count() / (batches * batchSize);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        key_holder.PartialDecrypt(share, d.first);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    timings.partial_decrypt = std::chrono::duration<double, std::milli>(end - start).count() / rounds;
+
+    return timings;
+}
+
+// Function to time a number of encryptions in milliseconds per operation
+double TimeEncrypt(KeyHolder &key_holder, int rounds) {
+    Ciphertext c;
+    NTL::ZZ plaintext(2);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        key_holder.Encrypt(c, plaintext);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / rounds;
+}
+
+// Function to time encryptions on num_threads threads sharing the key holder, in encryptions per second
+double EncryptThroughput(KeyHolder &key_holder, int rounds, unsigned num_threads) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) {
+        threads.emplace_back([&] {
+            Ciphertext c;
+            NTL::ZZ plaintext(2);
+            for (int i = 0; i < rounds; i++) {
+                key_holder.Encrypt(c, plaintext);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return num_threads * rounds / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <config.json> [rounds]" << std::endl;
+        return 1;
+    }
+
+    ExperimentConfig config;
+    NewConfigFromJsonFile(config, argv[1]);
+    int rounds = argc > 2 ? std::stoi(argv[2]) : defaultRounds;
+    const Options &options = config.options;
+
+    KeyHolder key_holder(options.p, options.alpha, options.phi_p_prime_factor_list);
+    key_holder.SetBatchIsa(options.simd_mul_mod);
+
+    // Encrypt with plain NTL::PowerMod
+    double plain = TimeEncrypt(key_holder, rounds);
+
+    // Encrypt with the fixed-base tables
+    auto start = std::chrono::high_resolution_clock::now();
+    key_holder.PrecomputeFixedBases(options.fixed_base_window_bits);
+    auto end = std::chrono::high_resolution_clock::now();
+    double build = std::chrono::duration<double, std::milli>(end - start).count();
+    uint64 table_bytes = key_holder.FixedBaseTableBytes();
+    double fixed_base = TimeEncrypt(key_holder, rounds);
+
+    // Encrypt with short exponents and tables sized for them
+    double short_exponent = 0;
+    if (options.short_exponent_bits > 0) {
+        key_holder.SetShortExponentBits(options.short_exponent_bits);
+        key_holder.PrecomputeFixedBases(options.fixed_base_window_bits);
+        short_exponent = TimeEncrypt(key_holder, rounds);
+    }
+
+    // Every thread draws its randomness from its own stream, so the throughput should grow with the threads
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    double single_throughput = EncryptThroughput(key_holder, rounds, 1);
+    double parallel_throughput = EncryptThroughput(key_holder, rounds, num_threads);
+
+    std::stringstream ss;
+    ss << "-----------------------------------\n"
+       << std::left << std::setw(26) << "Modulus bits: " << NTL::NumBits(options.p) << "\n"
+       << std::left << std::setw(26) << "Rounds: " << rounds << "\n"
+       << std::left << std::setw(26) << "Window bits: " << options.fixed_base_window_bits << "\n"
+       << std::left << std::setw(26) << "Batch SIMD kernel: " << key_holder.backend().BatchIsa() << "\n"
+       << "-----------------------------------\n"
+       << std::fixed << std::setprecision(4)
+       << std::left << std::setw(26) << "Table size: " << FormatBytes(table_bytes) << "\n"
+       << std::left << std::setw(26) << "Table build time: " << build << "ms\n"
+       << std::left << std::setw(26) << "Encrypt (PowerMod): " << plain << "ms/op\n"
+       << std::left << std::setw(26) << "Encrypt (fixed-base): " << fixed_base << "ms/op\n"
+       << std::left << std::setw(26) << "Speedup: " << plain / fixed_base << "x\n";
+    if (options.short_exponent_bits > 0) {
+        ss << "-----------------------------------\n"
+           << std::left << std::setw(26) << "Short exponent bits: " << options.short_exponent_bits << "\n"
+           << std::left << std::setw(26) << "Encrypt (short exp.): " << short_exponent << "ms/op\n"
+           << std::left << std::setw(26) << "Speedup: " << plain / short_exponent << "x\n";
+    }
+    ss << "-----------------------------------\n"
+       << std::left << std::setw(26) << "Encrypt, 1 thread: " << single_throughput << "/s\n"
+       << std::left << std::setw(26) << ("Encrypt, " + std::to_string(num_threads) + " threads: ")
+       << parallel_throughput << "/s\n"
+       << std::left << std::setw(26) << "Scaling: " << parallel_throughput / single_throughput << "x\n"
+       << "-----------------------------------\n";
+
+    // Compare the NTL backend with the fixed-limb Montgomery backend
+    BackendTimings ntl = TimeBackend<NtlBackend>(options, rounds);
+    BackendTimings montgomery{};
+    int limbs = MontgomeryLimbsForBits(NTL::NumBits(options.p));
+    switch (limbs) {
+        case 20:
+            montgomery = TimeBackend<MontgomeryBackend<20>>(options, rounds);
+            break;
+        case 36:
+            montgomery = TimeBackend<MontgomeryBackend<36>>(options, rounds);
+            break;
+        case 52:
+            montgomery = TimeBackend<MontgomeryBackend<52>>(options, rounds);
+            break;
+        default:
+            break;
+    }
+
+    ss << std::left << std::setw(26) << "Backend (ms/op): " << std::setw(12) << "NTL"
+       << std::setw(12) << "Montgomery" << "Speedup\n";
+    auto row = [&](const std::string &name, double a, double b) {
+        ss << std::left << std::setw(26) << name << std::setw(12) << a;
+        if (limbs != 0) {
+            ss << std::setw(12) << b << a / b << "x\n";
+        } else {
+            ss << std::setw(12) << "-" << "-\n";
+        }
+    };
+    row("Mul: ", ntl.mul, montgomery.mul);
+    row("Power (q): ", ntl.power, montgomery.power);
+    row("Mul (batch): ", ntl.mul_batch, montgomery.mul_batch);
+    row("Power (q, batch): ", ntl.power_batch, montgomery.power_batch);
+    row("PartialDecrypt: ", ntl.partial_decrypt, montgomery.partial_decrypt);
+    if (limbs == 0) {
+        ss << "No Montgomery backend is instantiated for " << NTL::NumBits(options.p) << "-bit moduli\n";
+    }
+    ss << "-----------------------------------\n";
+    std::cout << ss.str() << std::endl;
+
+    return 0;
+}
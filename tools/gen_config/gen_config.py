@@ -41,9 +41,26 @@ parser.add_argument(
 parser.add_argument(
     "--concurrency_level",
     type=int,
-    help="The number of threads for each party",
+    help="The number of network channels to each peer",
     default=1
 )
+parser.add_argument(
+    "--connections_per_peer",
+    type=int,
+    help="The number of sockets the channels to each peer are multiplexed over, 0 opens one per channel",
+    default=0
+)
+parser.add_argument(
+    "--num_worker_threads",
+    type=int,
+    help="The number of compute threads for each party, 0 uses the concurrency level",
+    default=0
+)
+
+parser.add_argument(
+    "--pin_worker_threads",
+    action="store_true",
+    help="Pin the compute threads to cores, filling the NUMA nodes in order")
 
 parser.add_argument(
     "--server_port",
@@ -68,6 +85,112 @@ parser.add_argument(
 parser.add_argument("-q", "--q", type=int, help="The q value", default=11)
 parser.add_argument("--q_power", type=int, help="The power of q", default=55)
 
+parser.add_argument(
+    "--fixed_base_window_bits",
+    type=int,
+    help="The window width of the fixed-base exponentiation tables, 0 disables them",
+    default=6)
+
+parser.add_argument(
+    "--short_exponent_bits",
+    type=int,
+    help="The length of the ElGamal encryption randomness in bits, 0 draws it below p",
+    default=0)
+
+parser.add_argument(
+    "--simd_mul_mod",
+    choices=["auto", "avx512ifma", "avx2", "none"],
+    help="The instruction set of the batched modular multiplications, auto uses AVX-512 IFMA when present",
+    default="auto")
+
+parser.add_argument(
+    "--ring_pass_chunk_size",
+    type=int,
+    help="The number of ciphertexts per ring pass message",
+    default=256)
+
+parser.add_argument(
+    "--max_in_flight_bytes",
+    type=int,
+    help="The limit of bytes queued for asynchronous sending per channel",
+    default=8 << 20)
+
+parser.add_argument(
+    "--transport",
+    choices=["tcp", "shm"],
+    help="The transport between the local parties, shm moves the data to shared memory after a TCP handshake",
+    default="tcp")
+
+parser.add_argument(
+    "--network_backend",
+    choices=["tcp", "io_uring"],
+    help="The network backend, io_uring batches the socket I/O of all channels (Linux only)",
+    default="tcp")
+
+parser.add_argument(
+    "--zero_copy_send",
+    action="store_true",
+    help="Send large payloads with zero copy, io_uring backend only")
+
+parser.add_argument(
+    "--bloom_filter_block_size",
+    type=int,
+    help="The positions per block of a blocked Bloom filter, a power of two of at least the number of hash "
+         "functions, 0 for an unblocked filter",
+    default=0)
+
+parser.add_argument(
+    "--dlog_table_max_entries",
+    type=int,
+    help="The limit of products in the server's vote count lookup table, 0 disables it",
+    default=1 << 20)
+
+parser.add_argument(
+    "--rerand_pool_size",
+    type=int,
+    help="The number of pooled encryptions of 1 that rerandomizers are multiplied from, 0 encrypts every one",
+    default=0)
+
+parser.add_argument(
+    "--rerand_subset_size",
+    type=int,
+    help="The number of pooled encryptions per rerandomizer, 0 picks the smallest one for --rerand_security_bits",
+    default=0)
+
+parser.add_argument(
+    "--rerand_security_bits",
+    type=int,
+    help="The security level the rerandomizer subset size is picked for",
+    default=128)
+
+parser.add_argument(
+    "--preprocessing_dir",
+    help="The directory of the persisted keys and preprocessing stores, empty disables them",
+    default="")
+
+parser.add_argument(
+    "--stream_prepare",
+    action="store_true",
+    help="Encrypt the bases and rerandomizers chunk by chunk during the ring pass")
+
+parser.add_argument(
+    "--memory_budget_mb",
+    type=int,
+    help="The memory in MiB for the per-position arrays of the ring pass, 0 keeps them whole",
+    default=0)
+
+parser.add_argument(
+    "--spill_dir",
+    help="The directory of the server's file of returned ciphertexts, empty uses the temp directory",
+    default="")
+
+parser.add_argument(
+    "--membership_test_tile_size",
+    type=int,
+    help="The number of elements whose bases the server reads in Bloom filter position order, 0 reads them "
+         "in input order",
+    default=4096)
+
 parser.add_argument("--no_print", action="store_true", help="Do not print to output")
 
 # Parse the arguments
@@ -123,19 +246,72 @@ def get_bf_size(n, p, t, l):
     return bf_size(n * (t - l + 1), p)
 
 
+def blocked_bf_fpr(n, m, k, b):
+    """Calculates the false positive rate of a blocked Bloom filter with m positions in blocks of b.
+    The number of elements in a block is Poisson distributed with mean n*b/m, and a block holding
+    i elements behaves like a classic filter of b positions with i elements."""
+    mean = n * b / m
+    fpr = 0.0
+    i = 0
+    while i <= mean + 20 * math.sqrt(mean) + 50:
+        log_weight = -mean + i * math.log(mean) - math.lgamma(i + 1)
+        fpr += math.exp(log_weight) * (1 - (1 - 1 / b) ** (i * k)) ** k
+        i += 1
+    return fpr
+
+
+def blocked_bf_size(n, p, k, b):
+    """Calculates the smallest blocked Bloom filter size, a multiple of b, reaching false positive rate p"""
+    m = math.ceil(bf_size(n, p) / b) * b
+    while blocked_bf_fpr(n, m, k, b) > p:
+        m = math.ceil(m * 1.01 / b) * b
+    return m
+
+
 def get_number_of_hash_functions(p):
     """Calculates the number of hash functions for a Bloom filter given m and n"""
     return int(round(-math.log2(p), 0))
 
 
-bloom_filter_size = get_bf_size(
-    args.set_size,
-    2**-(args.false_positive_rate),
-    args.number_of_parties,
-    args.intersection_threshold)
+def min_short_exponent_bits(p, large_prime_factor, security_bits=128):
+    """Calculates the shortest exponent length giving security_bits of security.
+    Pohlig-Hellman reveals the exponent modulo the smooth part (p-1)/large_prime_factor,
+    and a kangaroo search over the remaining bits costs 2^(remaining/2)."""
+    smooth_bits = ((p - 1) // large_prime_factor).bit_length()
+    return smooth_bits + 2 * security_bits
+
+
+def min_rerand_subset_size(pool_size, security_bits=128):
+    """Calculates the smallest subset size whose subset products give security_bits of security.
+    A meet-in-the-middle search over the C(pool_size, s) subsets costs about their square root,
+    so log2 C(pool_size, s) must reach 2 * security_bits. Returns 0 if no subset size does."""
+    for s in range(1, pool_size // 2 + 1):
+        if math.log2(math.comb(pool_size, s)) >= 2 * security_bits:
+            return s
+    return 0
+
 
 number_of_hash_functions = get_number_of_hash_functions(2**-args.false_positive_rate)
 
+if args.bloom_filter_block_size < 0:
+    parser.error("--bloom_filter_block_size must not be negative")
+if args.bloom_filter_block_size > 0:
+    if args.bloom_filter_block_size & (args.bloom_filter_block_size - 1) != 0:
+        parser.error("--bloom_filter_block_size must be a power of two")
+    if args.bloom_filter_block_size < number_of_hash_functions:
+        parser.error(f"--bloom_filter_block_size must be at least the number of hash functions, {number_of_hash_functions}")
+    bloom_filter_size = blocked_bf_size(
+        args.set_size * (args.number_of_parties - args.intersection_threshold + 1),
+        2**-(args.false_positive_rate),
+        number_of_hash_functions,
+        args.bloom_filter_block_size)
+else:
+    bloom_filter_size = get_bf_size(
+        args.set_size,
+        2**-(args.false_positive_rate),
+        args.number_of_parties,
+        args.intersection_threshold)
+
 # Check if the no_print argument is set
 if not args.no_print:
     # Access and print the values of the arguments
@@ -149,8 +325,29 @@ if not args.no_print:
     print(f"The power of q is: {args.q_power}")
     print(f"The number of bits in p is: {args.p_bits}")
     print(f"The size of bloom filter is: {bloom_filter_size}")
+    if args.bloom_filter_block_size > 0:
+        unblocked_size = get_bf_size(args.set_size, 2**-(args.false_positive_rate),
+                                     args.number_of_parties, args.intersection_threshold)
+        print(f"The blocked bloom filter is {100 * (bloom_filter_size / unblocked_size - 1):.1f}% "
+              f"larger than an unblocked one")
     print(f"The number of hash functions is: {number_of_hash_functions}")
 
+rerand_subset_size = args.rerand_subset_size
+if args.rerand_pool_size > 0:
+    if rerand_subset_size == 0:
+        rerand_subset_size = min_rerand_subset_size(args.rerand_pool_size, args.rerand_security_bits)
+        if rerand_subset_size == 0:
+            parser.error(f"--rerand_pool_size {args.rerand_pool_size} is too small for "
+                         f"{args.rerand_security_bits}-bit security")
+    if not args.no_print:
+        print(f"The rerandomizers multiply {rerand_subset_size} of {args.rerand_pool_size} pooled encryptions, "
+              f"log2 C(n, s) = {math.log2(math.comb(args.rerand_pool_size, rerand_subset_size)):.1f}")
+
+short_exponent_floor = min_short_exponent_bits(args.p, args.prime_factor_1)
+if 0 < args.short_exponent_bits < short_exponent_floor:
+    print(f"warning: short exponents of {args.short_exponent_bits} bits give less than 128-bit security "
+          f"for this p, use at least {short_exponent_floor} bits")
+
 # hash functions
 murmurhash_seeds = [random.randint(2, INT_MAX)
                     for _ in range(number_of_hash_functions)]
@@ -170,6 +367,7 @@ if args.q != 2:
 config = {
     "setSize": args.set_size,
     "bloomFilterSize": bloom_filter_size,
+    "bloomFilterBlockSize": args.bloom_filter_block_size,
     "falsePositiveRate": args.false_positive_rate,
     "sameNum": args.set_size,
     "sameSeed": same_seed,
@@ -192,7 +390,25 @@ config = {
     "q": str(args.q),
     "qPower": str(args.q_power),
     "alpha": str(alpha),
-    "bufferSize": buffer_size
+    "bufferSize": buffer_size,
+    "fixedBaseWindowBits": args.fixed_base_window_bits,
+    "shortExponentBits": args.short_exponent_bits,
+    "simdMulMod": args.simd_mul_mod,
+    "ringPassChunkSize": args.ring_pass_chunk_size,
+    "maxInFlightBytes": args.max_in_flight_bytes,
+    "networkBackend": args.network_backend,
+    "zeroCopySend": args.zero_copy_send,
+    "dlogTableMaxEntries": args.dlog_table_max_entries,
+    "rerandPoolSize": args.rerand_pool_size,
+    "rerandSubsetSize": rerand_subset_size,
+    "preprocessingDir": args.preprocessing_dir,
+    "numWorkerThreads": args.num_worker_threads,
+    "pinWorkerThreads": args.pin_worker_threads,
+    "streamPrepare": args.stream_prepare,
+    "connectionsPerPeer": args.connections_per_peer,
+    "memoryBudgetMb": args.memory_budget_mb,
+    "spillDir": args.spill_dir,
+    "membershipTestTileSize": args.membership_test_tile_size
 }
 
 # clean the dir
@@ -201,6 +417,7 @@ for f in os.listdir(dir):
     os.remove(os.path.join(dir, f))
 
 # compose the config JSON and write to file
+address_prefix = ("shm://" if args.transport == "shm" else "") + "127.0.0.1:"
 diffSeeds = []
 for i in range(0, args.number_of_parties):
     config["sameNum"] = max([args.set_size - (i) * diff_step, same_amount])
@@ -218,8 +435,8 @@ for i in range(0, args.number_of_parties):
     config["port"] = args.server_port + i 
     config["id"] = i 
     config["localName"] = "P" + str(i)
-    config["serverAddress"] = "127.0.0.1:" + str(args.server_port)
-    config["rightNeighborAddress"] = "127.0.0.1:" + \
+    config["serverAddress"] = address_prefix + str(args.server_port)
+    config["rightNeighborAddress"] = address_prefix + \
                                      str(args.server_port + (i+1) % (args.number_of_parties))
 
     json_object = json.dumps(config, indent=4)
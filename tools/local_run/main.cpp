@@ -0,0 +1,85 @@
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "network/loopback_endpoint.h"
+#include "protocol/participant.h"
+#include "utils/common.h"
+#include "utils/utils.h"
+
+// Runs all parties of an experiment as threads of one process, connected by loopback endpoints.
+// Usage: local_run <P0_config.json> <P1_config.json> ...
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <config.json> <config.json> ..." << std::endl;
+        return 1;
+    }
+
+    std::vector<ExperimentConfig> configs(argc - 1);
+    for (int i = 1; i < argc; i++) {
+        NewConfigFromJsonFile(configs[i - 1], argv[i]);
+    }
+
+    // All endpoints are registered before any party starts connecting
+    LoopbackNetwork network;
+    std::vector<std::unique_ptr<LoopbackEndpoint>> endpoints;
+    for (const auto &config: configs) {
+        endpoints.push_back(std::make_unique<LoopbackEndpoint>(network, config.options.port));
+    }
+
+    std::vector<std::vector<long long>> durations(configs.size());
+    std::vector<uint64> bytes_sent(configs.size());
+    std::vector<uint64> bytes_received(configs.size());
+    int server_index = -1;
+
+    auto party = [&](size_t i) {
+        const ExperimentConfig &config = configs[i];
+        std::vector<ElementType> set;
+        set.reserve(config.element_set_size);
+        generate_set(set, config);
+
+        Participant participant(config.options, set, MultiplexEndpoint(std::move(endpoints[i]), config.options));
+        participant.Initialize();
+        participant.RingLatency(false);
+        durations[i] = participant.Execute(config.options.role == Role::server);
+        bytes_sent[i] = participant.GetTotalBytesSent();
+        bytes_received[i] = participant.GetTotalBytesReceived();
+        participant.Stop();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < configs.size(); i++) {
+        assert(configs[i].options.num_parties - configs[i].options.intersection_threshold < configs[i].options.power_q);
+        assert(configs[i].options.num_hash_functions < configs[i].options.q);
+        if (configs[i].options.role == Role::server) {
+            server_index = i;
+        }
+        threads.emplace_back(party, i);
+    }
+    for (auto &th: threads) {
+        th.join();
+    }
+
+    if (server_index < 0) {
+        return 0;
+    }
+
+    const Options &options = configs[server_index].options;
+    std::stringstream ss;
+    ss << "-----------------------------------\n"
+       << std::left << std::setw(26) << "Number of parties: " << options.num_parties << "\n"
+       << std::left << std::setw(26) << "Intersection threshold: " << options.intersection_threshold << "\n"
+       << std::left << std::setw(26) << "Set size: " << configs[server_index].element_set_size << "\n"
+       << std::left << std::setw(26) << "Hardware threads: " << std::thread::hardware_concurrency() << "\n"
+       << "-----------------------------------\n"
+       << std::left << std::setw(26) << "Total execution time: "
+       << (durations[server_index][0] + durations[server_index][1]) << "ms \n"
+       << std::left << std::setw(26) << "Preparation time: " << durations[server_index][0] << "ms \n"
+       << std::left << std::setw(26) << "Online time: " << durations[server_index][1] << "ms \n"
+       << std::left << std::setw(26) << "Server data sent: " << FormatBytes(bytes_sent[server_index]) << " \n"
+       << std::left << std::setw(26) << "Server data received: " << FormatBytes(bytes_received[server_index]) << "\n";
+    std::cout << ss.str() << std::endl;
+
+    return 0;
+}
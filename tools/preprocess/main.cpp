@@ -0,0 +1,38 @@
+#include <iostream>
+#include <string>
+
+#include "network/loopback_endpoint.h"
+#include "protocol/participant.h"
+#include "utils/common.h"
+#include "utils/utils.h"
+
+// Generates preprocessing bundles for one party ahead of its runs, without any network. The party must
+// have run the protocol once with preprocessingDir set so that its key is persisted.
+// Usage: preprocess <config.json> <bundles>
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <config.json> <bundles>" << std::endl;
+        return 1;
+    }
+
+    ExperimentConfig config;
+    NewConfigFromJsonFile(config, argv[1]);
+    uint64 bundles = std::stoull(argv[2]);
+
+    // The participant needs an endpoint, an unconnected loopback one opens no socket
+    LoopbackNetwork network;
+    Participant participant(config.options, {}, std::make_unique<LoopbackEndpoint>(network, config.options.port));
+
+    try {
+        uint64 available = participant.Preprocess(bundles);
+        std::cout << config.options.local_name << ": " << available << " preprocessing bundles available"
+                  << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        participant.Stop();
+        return 1;
+    }
+
+    participant.Stop();
+    return 0;
+}